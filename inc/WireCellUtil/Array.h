@@ -19,6 +19,14 @@
 
    - In Wire Cell large arrays are accessed via const shared pointer.
 
+   The row and column passes of the transforms below are split across
+   the threads configured with Parallel::set_nthreads() (serial by
+   default).  Results are identical for any number of threads.
+
+   Eigen arrays are column-major so each row is strided in memory.
+   The row passes transpose blocks of rows into contiguous tiles
+   before transforming them, see set_row_block().
+
    Usage examples are given below.
  */ 
 
@@ -31,6 +39,7 @@
 #include <Eigen/Core>
 
 #include <memory>
+#include <mutex>
 #include <vector>
 
 
@@ -40,6 +49,7 @@ namespace WireCell {
 
 	typedef Eigen::ArrayXf array_xf;
 	typedef Eigen::ArrayXcf array_xc;
+	typedef Eigen::ArrayXd array_xd;
 
         /// A 16 bit short integer 2D array.
         typedef Eigen::Array<short, Eigen::Dynamic, Eigen::Dynamic> array_xxs;
@@ -56,6 +66,51 @@ namespace WireCell {
 	/// A complex, 2D array
 	typedef Eigen::ArrayXXcf array_xxc;
 
+	/// Double precision real and complex 2D arrays.
+	typedef Eigen::ArrayXXd array_xxd;
+	typedef Eigen::ArrayXXcd array_xxcd;
+
+	/// Real and complex 2D arrays of a given precision.
+	template<typename Real>
+	using array_xxr = Eigen::Array<Real, Eigen::Dynamic, Eigen::Dynamic>;
+	template<typename Real>
+	using array_xxz = Eigen::Array<std::complex<Real>, Eigen::Dynamic, Eigen::Dynamic>;
+
+
+	/** FFT-friendly padding of the tick (column) dimension.
+
+	    Transforms of lengths with large prime factors are slow.
+	    These functions extend each row to fft_best_length() of
+	    the number of columns, with zeros or a reflection (see
+	    Waveform::PadType), transform, and crop the result back.
+	    The number of columns added is reported in npad.
+
+	    int npad = 0;
+	    auto spec = dft_padded(arr, npad);  // arr.cols()+npad columns
+	    auto arr2 = idft_cropped(spec, npad);  // arr.cols() columns
+
+	    deconv_padded() needs a filter with padded_cols() columns
+	    and returns an array of the shape of its input.
+	    idft_cropped() throws ValueError unless 0 <= npad <=
+	    spec.cols().
+	 */
+	int padded_cols(int ncols);
+	array_xxf pad(const array_xxf& arr, int ncols,
+		      Waveform::PadType type = Waveform::pad_zero);
+	array_xxc dft_padded(const array_xxf& arr, int& npad,
+			     Waveform::PadType type = Waveform::pad_zero);
+	array_xxf idft_cropped(const array_xxc& spec, int npad);
+	array_xxf deconv_padded(const array_xxf& arr, const array_xxc& filter,
+				Waveform::PadType type = Waveform::pad_zero);
+
+	/** Set the number of rows transposed together by the row
+	    passes of the transforms.  The default of 16 fills a
+	    64 byte cache line with real samples.  Zero or one
+	    disables the tiling and gathers each strided row on its
+	    own.  Results do not depend on this setting.
+	 */
+	void set_row_block(int nrows);
+	int row_block();
 
 	/** Perform full, 2D discrete Fourier transform on a real 2D
             array.
@@ -74,6 +129,15 @@ namespace WireCell {
 	array_xxc dft(const array_xxf& arr);
 	array_xxf idft(const array_xxc& arr);
 
+	/** As above but writing into caller-provided arrays which are
+	    resized as needed.  Reusing the same output arrays from
+	    one call to the next avoids heap allocation.  Note, this
+	    idft() uses spec as its working space and leaves it
+	    modified.
+	 */
+	void dft(const array_xxf& arr, array_xxc& spec);
+	void idft(array_xxc& spec, array_xxf& arr);
+
         /** Partial, 1D DFT and inverse DFT along one dimension of an
          * array.  Each row is transformed if dim=0, each column if
          * dim=1.  The transfer is either real->complex (rc),
@@ -116,6 +180,251 @@ namespace WireCell {
 	 */
 	array_xxf deconv(const array_xxf& arr, const array_xxc& filter);
 
+	/** Working space for in-place deconvolution.
+
+	    Hold one across events and pass it to deconv() or
+	    rdeconv() which then perform no heap allocation once it
+	    has grown to the frame size.
+	 */
+	template<typename Real>
+	class BasicWorkspace {
+	public:
+	    /// The complex spectrum, resized as needed.
+	    array_xxz<Real> spec;
+	};
+	typedef BasicWorkspace<float> Workspace;
+
+	/** Perform 2D deconvolution in place.  
+
+	    The result replaces the contents of arr.  A ValueError is
+	    thrown if the filter shape does not match.
+	 */
+	void deconv(array_xxf& arr, const array_xxc& filter, Workspace& ws);
+
+	/** Half-spectrum 2D DFT of a real array.
+
+	    The spectrum of a real array is Hermitian so its columns
+	    beyond ncols/2 carry no information.  rdft() returns only
+	    the first ncols/2+1 columns of what dft() returns.  The
+	    inverse, irdft(), needs the number of columns of the
+	    original array as it can not be inferred from the
+	    spectrum's.  A ValueError is thrown if the spectrum is not
+	    ncols/2+1 wide, as is one from rdeconv() if its filter is
+	    not.
+
+	    auto half = rdft(arr);
+	    // ...
+	    auto arr2 = irdft(half, arr.cols());
+	 */
+	array_xxc rdft(const array_xxf& arr);
+	array_xxf irdft(const array_xxc& arr, int ncols);
+
+	/// Output parameter forms of rdft() and irdft(), see dft().
+	void rdft(const array_xxf& arr, array_xxc& spec);
+	void irdft(array_xxc& spec, int ncols, array_xxf& arr);
+
+	/** Perform 2D deconvolution with a half-spectrum filter.
+
+	    The filter has shape (nrows, ncols/2+1).  The result is
+	    the same as deconv() given any full filter whose first
+	    ncols/2+1 columns equal this one, eg:
+
+	    rdeconv(arr, filter.leftCols(arr.cols()/2+1))
+	 */
+	array_xxf rdeconv(const array_xxf& arr, const array_xxc& filter);
+
+	/// In-place form of rdeconv(), see deconv().
+	void rdeconv(array_xxf& arr, const array_xxc& filter, Workspace& ws);
+
+	/** Precision-generic forms of the transforms above.
+
+	    These are instantiated for float and double.  The float
+	    functions above are these with Real=float.  Precision
+	    sensitive work, eg averaging responses, may use double
+	    arrays throughout without copying through float:
+
+	    array_xxd resp = ...;
+	    array_xxcd spec = dft(resp);
+	    array_xxd back = idft(spec);
+
+	    Being templates these only accept arrays of exactly the
+	    given types, not Eigen expressions.
+	 */
+	template<typename Real>
+	array_xxz<Real> dft(const array_xxr<Real>& arr);
+	template<typename Real>
+	void dft(const array_xxr<Real>& arr, array_xxz<Real>& spec);
+	template<typename Real>
+	array_xxr<Real> idft(const array_xxz<Real>& spec);
+	template<typename Real>
+	void idft(array_xxz<Real>& spec, array_xxr<Real>& arr);
+	template<typename Real>
+	array_xxz<Real> rdft(const array_xxr<Real>& arr);
+	template<typename Real>
+	void rdft(const array_xxr<Real>& arr, array_xxz<Real>& spec);
+	template<typename Real>
+	array_xxr<Real> irdft(const array_xxz<Real>& spec, int ncols);
+	template<typename Real>
+	void irdft(array_xxz<Real>& spec, int ncols, array_xxr<Real>& arr);
+	template<typename Real>
+	array_xxr<Real> deconv(const array_xxr<Real>& arr, const array_xxz<Real>& filter);
+	template<typename Real>
+	void deconv(array_xxr<Real>& arr, const array_xxz<Real>& filter, BasicWorkspace<Real>& ws);
+	template<typename Real>
+	array_xxr<Real> rdeconv(const array_xxr<Real>& arr, const array_xxz<Real>& filter);
+	template<typename Real>
+	void rdeconv(array_xxr<Real>& arr, const array_xxz<Real>& filter, BasicWorkspace<Real>& ws);
+
+	/** 2D DFT of raw ADC counts.
+
+	    Each row has its pedestal subtracted and is converted to
+	    float on the fly, tile by tile, inside the row pass so no
+	    float copy of the frame is made.  The result equals dft()
+	    (or rdft()) of the float array adc - pedestal.  An empty
+	    pedestals vector means zero pedestals, otherwise it must
+	    hold one per row or a ValueError is thrown.
+	 */
+	array_xxc dft(const array_xxs& adc, const std::vector<float>& pedestals);
+	void dft(const array_xxs& adc, const std::vector<float>& pedestals, array_xxc& spec);
+	void rdft(const array_xxs& adc, const std::vector<float>& pedestals, array_xxc& spec);
+
+	/** Mean and population RMS of every row, as given by
+	    Waveform::mean_rms() of each row.  The frame is swept
+	    column by column, contiguously, accumulating all rows of
+	    a block at once in double.  Blocks of rows are spread
+	    over Parallel::nthreads().
+	 */
+	void mean_rms(const array_xxf& arr, array_xd& mean, array_xd& rms);
+
+	/** Waveform::most_frequent() of each row, eg the pedestal of
+	    each channel of a frame of ADC counts.  Rows are spread
+	    over Parallel::nthreads().
+	 */
+	std::vector<short> most_frequent(const array_xxs& adc);
+
+	/** Sparse-frame transforms.
+
+	    After noise filtering and ROI finding many rows (channels)
+	    of a frame may be entirely zero.  Their row transforms are
+	    zero and may be skipped.  Only the row pass benefits, the
+	    column pass is done in full.
+
+	    active_rows() returns the indices of rows holding any
+	    non-zero sample, scanning memory contiguously.
+	    dft_sparse() is dft() using it.  The other forms take a
+	    caller's list of rows and treat every other row as zero
+	    without looking at it.  The list must be strictly
+	    increasing, as active_rows() returns, else a ValueError is
+	    thrown.  An IndexError is thrown if a row index is out of
+	    range.
+	 */
+	std::vector<int> active_rows(const array_xxf& arr);
+	array_xxc dft_sparse(const array_xxf& arr);
+	void dft(const array_xxf& arr, array_xxc& spec, const std::vector<int>& rows);
+	void rdft(const array_xxf& arr, array_xxc& spec, const std::vector<int>& rows);
+	void deconv(array_xxf& arr, const array_xxc& filter, Workspace& ws,
+		    const std::vector<int>& rows);
+	void rdeconv(array_xxf& arr, const array_xxc& filter, Workspace& ws,
+		     const std::vector<int>& rows);
+
+	/** A 2D deconvolution engine for many frames of one shape.
+
+	    Build once from a filter, either a full (nrows, ncols) or a
+	    half-spectrum (nrows, ncols/2+1) one, and reuse it for
+	    every plane and every event sharing that filter.  Only
+	    the half-spectrum is kept.  Working space is held across
+	    calls, one per frame in flight, so deconvolving single
+	    frames does not allocate once warmed up.
+
+	    Deconvolver deco(filter, nrows, ncols);
+	    deco(frame);        // one frame, in place
+	    deco(frames);       // a batch, in place, in parallel
+
+	    A batch is spread over Parallel::nthreads() threads, one
+	    frame at a time per thread.  Results are identical to
+	    rdeconv() of each frame.
+	 */
+	class Deconvolver {
+	public:
+	    Deconvolver(const array_xxc& filter, int nrows, int ncols);
+	    ~Deconvolver();
+
+	    int rows() const { return m_nrows; }
+	    int cols() const { return m_ncols; }
+
+	    /// The half-spectrum filter in use.
+	    const array_xxc& filter() const { return m_filter; }
+
+	    /// Deconvolve one frame in place.  A ValueError is thrown
+	    /// if its shape does not match.
+	    void operator()(array_xxf& frame);
+
+	    /// Deconvolve a batch of frames in place.
+	    void operator()(std::vector<array_xxf>& frames);
+
+	private:
+	    Workspace* acquire();
+	    void release(Workspace* ws);
+
+	    int m_nrows, m_ncols;
+	    array_xxc m_filter;
+	    std::mutex m_mutex;
+	    std::vector<std::unique_ptr<Workspace> > m_all;
+	    std::vector<Workspace*> m_free;
+	};
+
+	/** Streaming 2D deconvolution along the tick dimension.
+
+	    Deconvolve a readout of any length, delivered in chunks of
+	    columns (ticks), using overlap-save.  Memory is bounded by
+	    a few arrays of nblock columns.
+
+	    The deconvolution is given by its real-space kernel of
+	    shape (nrows, K).  Column m of the kernel applies at a
+	    tick offset of m-pre, so pre is the number of acausal
+	    ticks.  Rows (channels) are treated circularly as in
+	    deconv().  The transform block length nblock must exceed
+	    K-1 and each block yields nblock-K+1 ticks.
+
+	    StreamDeconvolver sd(kernel, pre, nblock);
+	    for (auto& chunk : chunks) {
+	        consume(sd(chunk));   // zero or more deconvolved ticks
+	    }
+	    consume(sd.flush());      // the rest, stream restarts
+
+	    In total exactly as many ticks are emitted as were fed.
+	    Ticks before the start and after the end of the stream are
+	    taken as zero.  For a frame of F ticks the output equals
+	    deconv() with the filter dft() of the kernel wrapped into
+	    F columns over ticks [K-1-pre, F-pre), where the circular
+	    wrap-around of deconv() does not reach.
+	 */
+	class StreamDeconvolver {
+	public:
+	    StreamDeconvolver(const array_xxf& kernel, int pre, int nblock);
+
+	    /// Return the real-space kernel with pre acausal and post
+	    /// causal ticks of the deconvolution by a full filter.
+	    static array_xxf kernel(const array_xxc& filter, int pre, int post);
+
+	    /// Feed a chunk of ticks, return the ticks now complete.
+	    array_xxf operator()(const array_xxf& chunk);
+
+	    /// Return all remaining ticks and restart the stream.
+	    array_xxf flush();
+
+	private:
+	    void reset();
+	    void process(array_xxf& out);
+
+	    int m_nrows, m_nkern, m_pre, m_nblock;
+	    array_xxc m_spec;   // half-spectrum of the kernel over a block
+	    array_xxf m_buffer, m_block;
+	    Workspace m_ws;
+	    int m_nfill;        // columns in m_buffer
+	    long m_nin, m_nout; // ticks fed and emitted
+	};
+
     }
 }
 
@@ -0,0 +1,125 @@
+/**
+   Flat interval sets for bin ranges and channel masks.
+
+   A BinRangeSet holds disjoint, sorted, half-open bin ranges as one
+   flat vector of edges.  Ranges which overlap or touch are joined
+   and empty ranges are dropped.  Set operations are a single sweep
+   over the edges of both operands, so O(n+m).
+
+   A ChannelMaskSet holds a BinRangeSet for each of a sorted list of
+   channels, all in three flat vectors.  Channels are addressed by
+   their dense index in that list.  Channels with no ranges are not
+   kept.
+
+   Both convert to and from the BinRangeList and ChannelMasks of
+   Waveform.h.
+ */
+
+#ifndef WIRECELLUTIL_BINRANGESET
+#define WIRECELLUTIL_BINRANGESET
+
+#include "WireCellUtil/Waveform.h"
+
+#include <vector>
+
+namespace WireCell {
+
+    namespace Waveform {
+
+	class BinRangeSet {
+	public:
+	    BinRangeSet() {}
+
+	    /// Make from ranges in any order, which may overlap.
+	    explicit BinRangeSet(const BinRangeList& brl);
+
+	    /// Make from a flat list of edges [b0,e0,b1,e1,...] which
+	    /// must be strictly increasing.
+	    static BinRangeSet from_edges(std::vector<int> edges);
+
+	    /// Return the ranges in order.
+	    BinRangeList ranges() const;
+
+	    const std::vector<int>& edges() const { return m_edges; }
+
+	    /// Number of disjoint ranges.
+	    size_t size() const { return m_edges.size()/2; }
+	    bool empty() const { return m_edges.empty(); }
+
+	    /// Total number of bins covered.
+	    int nbins() const;
+
+	    /// True if bin is in one of the ranges.
+	    bool contains(int bin) const;
+
+	    /// Add the range [beg,end).
+	    void insert(int beg, int end);
+
+	    BinRangeSet& operator|=(const BinRangeSet& other);
+	    BinRangeSet& operator&=(const BinRangeSet& other);
+	    BinRangeSet& operator-=(const BinRangeSet& other);
+
+	    bool operator==(const BinRangeSet& other) const { return m_edges == other.m_edges; }
+	    bool operator!=(const BinRangeSet& other) const { return m_edges != other.m_edges; }
+
+	private:
+	    std::vector<int> m_edges;
+	};
+
+	/// Union, intersection and difference.
+	BinRangeSet operator|(const BinRangeSet& a, const BinRangeSet& b);
+	BinRangeSet operator&(const BinRangeSet& a, const BinRangeSet& b);
+	BinRangeSet operator-(const BinRangeSet& a, const BinRangeSet& b);
+
+
+	class ChannelMaskSet {
+	public:
+	    ChannelMaskSet() : m_offsets(1, 0) {}
+	    explicit ChannelMaskSet(const ChannelMasks& cm);
+
+	    /// Return as a map.
+	    ChannelMasks masks() const;
+
+	    /// Number of channels with any ranges.
+	    size_t nchannels() const { return m_channels.size(); }
+	    bool empty() const { return m_channels.empty(); }
+
+	    /// The channels in order.
+	    const std::vector<int>& channels() const { return m_channels; }
+
+	    /// Dense index of channel or -1 if it has no ranges.
+	    int index(int channel) const;
+
+	    /// Ranges of the channel at a dense index.
+	    BinRangeSet at(size_t index) const;
+
+	    /// Ranges of a channel, empty if it has none.
+	    BinRangeSet ranges(int channel) const;
+
+	    /// True if bin of channel is masked.
+	    bool contains(int channel, int bin) const;
+
+	    ChannelMaskSet& operator|=(const ChannelMaskSet& other);
+	    ChannelMaskSet& operator&=(const ChannelMaskSet& other);
+	    ChannelMaskSet& operator-=(const ChannelMaskSet& other);
+
+	    bool operator==(const ChannelMaskSet& other) const;
+	    bool operator!=(const ChannelMaskSet& other) const { return !(*this == other); }
+
+	private:
+	    template<typename Op>
+	    static ChannelMaskSet combine(const ChannelMaskSet& a, const ChannelMaskSet& b, Op op);
+
+	    std::vector<int> m_channels;
+	    // ranges of channel i are edges [m_offsets[i], m_offsets[i+1])
+	    std::vector<size_t> m_offsets;
+	    std::vector<int> m_edges;
+	};
+
+	ChannelMaskSet operator|(const ChannelMaskSet& a, const ChannelMaskSet& b);
+	ChannelMaskSet operator&(const ChannelMaskSet& a, const ChannelMaskSet& b);
+	ChannelMaskSet operator-(const ChannelMaskSet& a, const ChannelMaskSet& b);
+    }
+}
+
+#endif
@@ -0,0 +1,64 @@
+/**
+   Element-wise complex arithmetic for frequency-domain filtering.
+
+   These apply one operation over whole spectra, eg the filter
+   multiplication of a deconvolution.  On x86 the float versions use
+   explicit SIMD code chosen at run time from what the CPU supports
+   (SSE4.1, AVX2+FMA or AVX-512) with a scalar fallback elsewhere.
+   Double precision versions are scalar.
+
+   The output may alias either input.
+ */
+
+#ifndef WIRECELLUTIL_COMPLEXKERNELS
+#define WIRECELLUTIL_COMPLEXKERNELS
+
+#include <complex>
+#include <cstddef>
+#include <string>
+
+namespace WireCell {
+
+    namespace ComplexKernels {
+
+	enum Level { scalar=0, sse4, avx2, avx512 };
+
+	/// Return the instruction set level in use.
+	Level level();
+
+	/// Return the best level supported by this CPU.
+	Level best_level();
+
+	/// Use the given level, or the best supported one if it is
+	/// not supported.  Mostly for testing and benchmarking.
+	/// Returns the level actually used.
+	Level set_level(Level lvl);
+
+	/// Return a name for the level.
+	std::string level_name(Level lvl);
+
+	/// out[i] = a[i] * b[i]
+	void multiply(std::complex<float>* out, const std::complex<float>* a,
+		      const std::complex<float>* b, size_t n);
+	void multiply(std::complex<double>* out, const std::complex<double>* a,
+		      const std::complex<double>* b, size_t n);
+
+	/// out[i] = a[i] * conj(b[i])
+	void multiply_conj(std::complex<float>* out, const std::complex<float>* a,
+			   const std::complex<float>* b, size_t n);
+	void multiply_conj(std::complex<double>* out, const std::complex<double>* a,
+			   const std::complex<double>* b, size_t n);
+
+	/// out[i] = a[i] / b[i], or zero where |b[i]|^2 <= eps.
+	///
+	/// Computed as a*conj(b)/|b|^2 which, unlike std::complex
+	/// division, does not rescale so may overflow for |b| beyond
+	/// about 1e19 in float.
+	void divide(std::complex<float>* out, const std::complex<float>* a,
+		    const std::complex<float>* b, size_t n, float eps=0);
+	void divide(std::complex<double>* out, const std::complex<double>* a,
+		    const std::complex<double>* b, size_t n, double eps=0);
+    }
+}
+
+#endif
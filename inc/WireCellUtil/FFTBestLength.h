@@ -6,7 +6,23 @@
 namespace WireCell{
     // Return suggested number of samples for performing an FFT which
     // should have no worse performance than the input nsamples.
+    //
+    // This is the smallest length not less than nsamples with no
+    // prime factor larger than the configured maximum, optionally
+    // of the same parity as nsamples.  In calibrated mode the
+    // fastest of the nearby such lengths, as measured with the FFT
+    // backend, is returned instead.  Results are cached.
     std::size_t fft_best_length(size_t nsamples, bool keep_odd_even=false);
+
+    // Configure fft_best_length().  The max_prime may be 7 (the
+    // default), 11 or 13, else a ValueError is thrown.  Calibration
+    // times real forward and inverse transforms of each candidate
+    // length the first time it is considered, which is slow but
+    // done once per length and does not hold up other callers.
+    void fft_best_length_config(int max_prime=7, bool calibrate=false);
+
+    // Return true if n has no prime factor larger than max_prime.
+    bool fft_smooth(size_t n, int max_prime=7);
 }
 
 
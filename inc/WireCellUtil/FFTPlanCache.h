@@ -0,0 +1,146 @@
+/**
+   A cache of 1D FFT plans shared by the Array and Waveform transforms.
+
+   Setting up a transform (twiddle factors for the built-in Eigen
+   backend, an fftwf_plan when Eigen is configured to use FFTW) costs
+   about as much as transforming a few rows of a typical frame.  The
+   cache keeps FFT engines per thread so that anything built for a
+   given transform survives across calls and across events.
+
+   Plans are keyed by (size, direction, real/complex, memory layout,
+   precision).  Real and complex transforms, in float and double,
+   each have their own engine as the FFTW backend of Eigen keys its
+   plans only by size, direction and layout and would otherwise run
+   an r2c plan on complex data of the same size.
+   The first use of a key is serialized through a process-wide mutex
+   as FFTW planning is not thread safe.  Executing an already known
+   plan takes no lock.  The plans of a thread are destroyed under the
+   same mutex when the thread exits.  Strided input or output (eg, a row of a
+   column-major Eigen array) is gathered into per-thread contiguous
+   scratch so that one plan serves any stride.
+
+   Usage:
+
+     auto& fft = FFTPlanCache::local();
+     fft.fwd(spec.row(irow), arr.row(irow));
+     fft.inv(wave.row(irow), spec.row(irow));
+
+   The inverse transforms apply the 1/N normalization.  A real
+   inverse uses only the first N/2+1 bins of its input.  The rfwd()
+   and rinv() variants produce and consume only those bins.
+ */
+
+#ifndef WIRECELLUTIL_FFTPLANCACHE
+#define WIRECELLUTIL_FFTPLANCACHE
+
+#include <Eigen/Core>
+#include <unsupported/Eigen/FFT>
+
+#include <complex>
+#include <set>
+#include <tuple>
+#include <vector>
+
+namespace WireCell {
+
+    class FFTPlanCache {
+    public:
+
+	typedef float real_t;
+	typedef std::complex<float> complex_t;
+
+	/// Return the FFT plan cache of the calling thread.
+	static FFTPlanCache& local();
+
+	/// Return the number of plans created so far, summed over all
+	/// threads.  Mostly of interest for testing.
+	static size_t nplans();
+
+	/// Forward transform of n samples.  Real input gives the full,
+	/// n-bin Hermitian spectrum.  Strides count elements.
+	void fwd(complex_t* out, int ostride, const real_t* in, int istride, int n);
+	void fwd(complex_t* out, int ostride, const complex_t* in, int istride, int n);
+
+	/// Inverse transform of n bins, normalized by 1/n.
+	void inv(complex_t* out, int ostride, const complex_t* in, int istride, int n);
+	void inv(real_t* out, int ostride, const complex_t* in, int istride, int n);
+
+	/// Half-spectrum forward transform of n real samples giving
+	/// the n/2+1 bins up to and including Nyquist.
+	void rfwd(complex_t* out, int ostride, const real_t* in, int istride, int n);
+
+	/// Inverse of rfwd().  Reads n/2+1 bins, writes n samples.
+	void rinv(real_t* out, int ostride, const complex_t* in, int istride, int n);
+
+	/// Double precision versions of the above.
+	void fwd(std::complex<double>* out, int ostride, const double* in, int istride, int n);
+	void fwd(std::complex<double>* out, int ostride, const std::complex<double>* in, int istride, int n);
+	void inv(std::complex<double>* out, int ostride, const std::complex<double>* in, int istride, int n);
+	void inv(double* out, int ostride, const std::complex<double>* in, int istride, int n);
+	void rfwd(std::complex<double>* out, int ostride, const double* in, int istride, int n);
+	void rinv(double* out, int ostride, const std::complex<double>* in, int istride, int n);
+
+	/// Transform between Eigen vectors, rows or columns.  The
+	/// output must already have the size of the input.
+	template<typename Out, typename In>
+	void fwd(Out&& out, const In& in) {
+	    fwd(out.data(), out.innerStride(), in.data(), in.innerStride(), in.size());
+	}
+	template<typename Out, typename In>
+	void inv(Out&& out, const In& in) {
+	    inv(out.data(), out.innerStride(), in.data(), in.innerStride(), in.size());
+	}
+	template<typename Out, typename In>
+	void rfwd(Out&& out, const In& in) {
+	    rfwd(out.data(), out.innerStride(), in.data(), in.innerStride(), in.size());
+	}
+	template<typename Out, typename In>
+	void rinv(Out&& out, const In& in) {
+	    rinv(out.data(), out.innerStride(), in.data(), in.innerStride(), out.size());
+	}
+
+    private:
+
+	FFTPlanCache();
+	~FFTPlanCache();
+	FFTPlanCache(const FFTPlanCache&) = delete;
+	FFTPlanCache& operator=(const FFTPlanCache&) = delete;
+
+	// (size, inverse, real, layout, double precision)
+	typedef std::tuple<int, bool, bool, int, bool> key_t;
+
+	// Transform n samples, gathering nin and scattering nout.
+	template<typename Out, typename In>
+	void transform(Out* out, int ostride, int nout,
+		       const In* in, int istride, int nin,
+		       int n, bool inverse, bool half);
+
+	// Per-thread scratch, selected by sample type.
+	real_t* scratch_in(const real_t*, int n);
+	complex_t* scratch_in(const complex_t*, int n);
+	real_t* scratch_out(const real_t*, int n);
+	complex_t* scratch_out(const complex_t*, int n);
+	double* scratch_in(const double*, int n);
+	std::complex<double>* scratch_in(const std::complex<double>*, int n);
+	double* scratch_out(const double*, int n);
+	std::complex<double>* scratch_out(const std::complex<double>*, int n);
+
+	// Engine selected by precision and real or complex transform.
+	Eigen::FFT<float>& engine(float, bool real) { return real ? m_rengine : m_cengine; }
+	Eigen::FFT<double>& engine(double, bool real) { return real ? m_drengine : m_dcengine; }
+
+	template<typename Out, typename In>
+	void execute(Out* out, const In* in, int n, bool inverse, bool half);
+
+	Eigen::FFT<real_t> m_rengine, m_cengine;
+	std::set<key_t> m_known;
+	std::vector<real_t, Eigen::aligned_allocator<real_t> > m_rin, m_rout;
+	std::vector<complex_t, Eigen::aligned_allocator<complex_t> > m_cin, m_cout;
+	Eigen::FFT<double> m_drengine, m_dcengine;
+	std::vector<double, Eigen::aligned_allocator<double> > m_din, m_dout;
+	std::vector<std::complex<double>, Eigen::aligned_allocator<std::complex<double> > > m_zin, m_zout;
+    };
+
+}
+
+#endif
@@ -0,0 +1,118 @@
+/**
+   Simple fork/join parallelism over index ranges.
+
+   Some bulk operations (eg, the row and column passes of the 2D
+   transforms in WireCell::Array) consist of many independent pieces
+   of work.  They may split that work over a number of threads.  By
+   default only one thread, the caller's, is used.  A job which owns a
+   whole node can opt in to more:
+
+     Parallel::set_nthreads(16); // or 0 for one per hardware thread
+
+   Each piece of work is done identically regardless of which thread
+   does it, so results do not depend on the number of threads.
+
+   Pieces run on a pool of worker threads which are started as
+   needed and kept until exit.  Piece i of a call always goes to the
+   same worker so per-thread caches (eg FFTPlanCache and transform
+   scratch) stay warm from one call to the next.  Calls from
+   different threads take turns using the pool.
+
+   A for_range() called from inside a piece of another for_range()
+   runs serially so that, eg, a batch of frames processed in parallel
+   does not also split each frame's transforms over threads.
+ */
+
+#ifndef WIRECELLUTIL_PARALLEL
+#define WIRECELLUTIL_PARALLEL
+
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace WireCell {
+
+    namespace Parallel {
+
+	/// Set the default number of threads.  One means serial
+	/// execution in the calling thread.  Zero means one per
+	/// hardware thread.
+	void set_nthreads(int nthreads);
+
+	/// Return the default number of threads, always at least one.
+	int nthreads();
+
+	/// Return the for_range() nesting depth of the calling thread.
+	int& depth();
+
+	/// Call piece(context, ind) for ind in [0, npieces), ind 0 in
+	/// the calling thread and the others on pool workers, and
+	/// return when all are done.  This is the engine behind
+	/// for_range() which should be used instead.
+	void run_pieces(int npieces, void (*piece)(void*, int), void* context);
+
+	/** Call func(beg, end) on contiguous, disjoint pieces of the
+	    half-open range [0, n) which together cover it.
+
+	    At most nthreads pieces are made and one is done in the
+	    calling thread.  If nthreads is negative the default is
+	    used.  An exception thrown by func is rethrown to the
+	    caller after all pieces finish.
+	 */
+	template<typename Func>
+	void for_range(int n, Func func, int nthreads = -1) {
+	    if (nthreads < 0) {
+		nthreads = Parallel::nthreads();
+	    }
+	    if (nthreads == 0) {
+		nthreads = std::max(1u, std::thread::hardware_concurrency());
+	    }
+	    if (nthreads > n) {
+		nthreads = n;
+	    }
+	    if (depth() > 0) {
+		nthreads = 1;
+	    }
+	    if (nthreads <= 1) {
+		if (n > 0) {
+		    func(0, n);
+		}
+		return;
+	    }
+
+	    // Pieces run at depth one more than the caller.
+	    const int level = depth() + 1;
+
+	    // Keep the first error.  Nothing here allocates so a
+	    // steady state caller stays allocation free.
+	    std::exception_ptr error;
+	    std::mutex error_mutex;
+	    auto piece = [&](int ind) {
+		const int beg = (long)n*ind/nthreads;
+		const int end = (long)n*(ind+1)/nthreads;
+		const int saved = depth();
+		depth() = level;
+		try {
+		    func(beg, end);
+		}
+		catch (...) {
+		    std::lock_guard<std::mutex> lock(error_mutex);
+		    if (!error) {
+			error = std::current_exception();
+		    }
+		}
+		depth() = saved;
+	    };
+	    typedef decltype(piece) piece_t;
+	    run_pieces(nthreads, [](void* context, int ind) {
+		(*static_cast<piece_t*>(context))(ind);
+	    }, &piece);
+	    if (error) {
+		std::rethrow_exception(error);
+	    }
+	}
+    }
+}
+
+#endif
@@ -159,6 +159,13 @@ namespace WireCell {
 	    WireCell::Waveform::realseq_t generate(const WireCell::Waveform::Domain& domain, int nsamples);
 	    /// Lay down the function into a binned waveform.
 	    WireCell::Waveform::realseq_t generate(const WireCell::Binning& tbins);
+
+	    /// Sample a function of frequency, eg an HfFilter, on
+	    /// the half-spectrum grid of Waveform::rfft() for
+	    /// nsamples at a sampling frequency of max_freq.  This is
+	    /// the first nsamples/2+1 values of
+	    /// generate(Domain(0, max_freq), nsamples).
+	    WireCell::Waveform::realseq_t half_spectrum(double max_freq, int nsamples) const;
 	};
 
 	/// A functional object caching gain and shape.
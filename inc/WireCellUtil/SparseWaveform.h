@@ -0,0 +1,175 @@
+/**
+   Sparse waveforms holding only regions of interest.
+
+   A SparseWave is a waveform of some total number of samples of
+   which only segments, each a start tick and a run of samples, are
+   stored.  Samples outside the segments are zero.  Segments are
+   kept sorted and apart (neither overlapping nor touching) and their
+   samples are held in one flat vector, so memory and copying go as
+   the number of stored samples rather than the readout length.
+
+   auto sw = SparseWave::from_dense(wave, threshold, pad);
+   sw.scale(gain);
+   auto dense = sw.dense();
+
+   A SparseFrame holds a SparseWave for each of a list of channels,
+   all of the same number of ticks, and converts to and from rows of
+   a 2D (eg Eigen) array.
+ */
+
+#ifndef WIRECELLUTIL_SPARSEWAVEFORM
+#define WIRECELLUTIL_SPARSEWAVEFORM
+
+#include "WireCellUtil/Waveform.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace WireCell {
+
+    namespace Waveform {
+
+	class SparseWave {
+	public:
+	    explicit SparseWave(size_t nsamples=0) : m_nsamples(nsamples), m_offsets(1, 0) {}
+
+	    /// Keep the runs of samples with |value| > threshold,
+	    /// each widened by pad samples on either side, joining
+	    /// runs which then overlap or touch.  With the default
+	    /// threshold of zero just the zeros are dropped.
+	    static SparseWave from_dense(Span<const real_t> wave, real_t threshold=0, size_t pad=0);
+
+	    /// Return or fill the dense waveform of size() samples.
+	    realseq_t dense() const;
+	    void dense(Span<real_t> wave) const;
+
+	    /// Total number of samples including zeros.
+	    size_t size() const { return m_nsamples; }
+
+	    /// Number of samples stored in segments.
+	    size_t occupancy() const { return m_samples.size(); }
+
+	    size_t nsegments() const { return m_starts.size(); }
+	    bool empty() const { return m_starts.empty(); }
+
+	    /// The start tick, number of samples and samples of a segment.
+	    int start(size_t iseg) const { return m_starts[iseg]; }
+	    size_t length(size_t iseg) const { return m_offsets[iseg+1] - m_offsets[iseg]; }
+	    const real_t* samples(size_t iseg) const { return m_samples.data() + m_offsets[iseg]; }
+	    real_t* samples(size_t iseg) { return m_samples.data() + m_offsets[iseg]; }
+
+	    /// The segments as bin ranges.
+	    BinRangeList ranges() const;
+
+	    /// Value at tick, zero outside segments.
+	    real_t at(int tick) const;
+
+	    /// Add a segment of samples at start tick.  Samples where
+	    /// it overlaps existing segments are summed.  It must lie
+	    /// within the waveform.
+	    void add(int start, Span<const real_t> samples);
+
+	    /// Sum in another waveform of the same size.  Only the
+	    /// union of the segments is stored.
+	    SparseWave& operator+=(const SparseWave& other);
+
+	    /// Increase or scale the stored samples.  Samples outside
+	    /// the segments stay zero.
+	    void increase(real_t scalar);
+	    void scale(real_t scalar);
+
+	    /// Sum and sum of squares of all samples.
+	    real_t sum() const;
+	    real_t sum2() const;
+
+	private:
+	    size_t m_nsamples;
+	    std::vector<int> m_starts;
+	    // samples of segment i are [m_offsets[i], m_offsets[i+1])
+	    std::vector<size_t> m_offsets;
+	    realseq_t m_samples;
+	};
+
+	/// Return the sum of two sparse waveforms.
+	SparseWave operator+(const SparseWave& a, const SparseWave& b);
+
+
+	class SparseFrame {
+	public:
+	    explicit SparseFrame(size_t nticks=0) : m_nticks(nticks) {}
+
+	    /// Make from the rows of a 2D array, row i being
+	    /// channels[i].  See SparseWave::from_dense().  Rows are
+	    /// spread over Parallel::nthreads().  A ValueError is
+	    /// thrown unless there is one channel per row.
+	    template<typename Array2D>
+	    static SparseFrame from_dense(const Array2D& frame, const std::vector<int>& channels,
+					  real_t threshold=0, size_t pad=0) {
+		if ((size_t)frame.rows() != channels.size()) {
+		    size_mismatch("from_dense: channels and frame rows differ");
+		}
+		SparseFrame ret(frame.cols());
+		ret.m_channels = channels;
+		ret.m_waves.resize(channels.size());
+		Parallel::for_range(channels.size(), [&](int beg, int end) {
+		    for (int irow = beg; irow < end; ++irow) {
+			ret.m_waves[irow] = SparseWave::from_dense(frame.row(irow), threshold, pad);
+		    }
+		});
+		ret.reindex();
+		return ret;
+	    }
+
+	    /// Fill the rows of a 2D array, row i being the channel of
+	    /// index i.  It must have nchannels() rows and nticks()
+	    /// columns else a ValueError is thrown.
+	    template<typename Array2D>
+	    void dense(Array2D& frame) const {
+		if ((size_t)frame.rows() != m_channels.size() || (size_t)frame.cols() != m_nticks) {
+		    size_mismatch("dense: frame is not nchannels by nticks");
+		}
+		Parallel::for_range(m_waves.size(), [&](int beg, int end) {
+		    for (int irow = beg; irow < end; ++irow) {
+			m_waves[irow].dense(frame.row(irow));
+		    }
+		});
+	    }
+
+	    size_t nticks() const { return m_nticks; }
+	    size_t nchannels() const { return m_channels.size(); }
+
+	    /// The channels in the order they were added.
+	    const std::vector<int>& channels() const { return m_channels; }
+
+	    /// Index of channel or -1 if it is not held.
+	    int index(int channel) const;
+
+	    const SparseWave& at(size_t index) const { return m_waves[index]; }
+	    SparseWave& at(size_t index) { return m_waves[index]; }
+
+	    /// Add a waveform of nticks() samples for a channel, summing
+	    /// with any the channel already has.
+	    void add(int channel, const SparseWave& wave);
+
+	    /// Stored samples over all channels.
+	    size_t occupancy() const;
+
+	    /// Increase or scale the stored samples of all channels.
+	    void increase(real_t scalar);
+	    void scale(real_t scalar);
+
+	private:
+	    void reindex();
+	    // Throws ValueError, kept out of line so this header needs
+	    // no Exceptions.h.
+	    static void size_mismatch(const char* what);
+
+	    size_t m_nticks;
+	    std::vector<int> m_channels;
+	    std::vector<SparseWave> m_waves;
+	    std::unordered_map<int, size_t> m_index;
+	};
+    }
+}
+
+#endif
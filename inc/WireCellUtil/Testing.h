@@ -4,6 +4,8 @@
 #define BOOST_ENABLE_ASSERT_HANDLER 1
 #include <boost/assert.hpp>
 
+#include <chrono>
+
 #define Assert BOOST_ASSERT
 #define AssertMsg BOOST_ASSERT_MSG 
 
@@ -13,5 +15,34 @@ namespace boost
     void assertion_failed_msg(char const * expr, char const * msg, char const * function, char const * file, long line);
 }
 
+namespace WireCell {
+    namespace Testing {
+
+	/// Return the wall clock time in milliseconds taken by func().
+	template<typename Func>
+	double time_ms(Func func)
+	{
+	    auto t1 = std::chrono::high_resolution_clock::now();
+	    func();
+	    auto t2 = std::chrono::high_resolution_clock::now();
+	    return std::chrono::duration_cast<std::chrono::microseconds>(t2-t1).count()/1000.0;
+	}
+
+	/// Return the smallest time_ms() over ntimes calls of func(),
+	/// which is less noisy than the mean.
+	template<typename Func>
+	double best_time_ms(Func func, int ntimes)
+	{
+	    double best = 0;
+	    for (int ind=0; ind<ntimes; ++ind) {
+		const double dt = time_ms(func);
+		if (!ind || dt < best) {
+		    best = dt;
+		}
+	    }
+	    return best;
+	}
+    }
+}
 
 #endif
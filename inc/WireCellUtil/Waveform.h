@@ -1,6 +1,8 @@
 #ifndef WIRECELL_WAVEFORM
 #define WIRECELL_WAVEFORM
 
+#include "WireCellUtil/Parallel.h"
+
 #include <map>
 #include <cstdint>
 #include <vector>
@@ -8,6 +10,8 @@
 #include <numeric>
 #include <algorithm>
 #include <string>
+#include <type_traits>
+#include <utility>
 
 namespace WireCell {
 
@@ -33,6 +37,58 @@ namespace WireCell {
 	/// A complex-valued sequence, eg for discrete spectrum powers.
 	typedef Sequence<complex_t> compseq_t;
 
+	/// A non-owning view of size values spaced stride apart.
+	/// It may be made from a pointer, a std::vector or any Eigen
+	/// vector, row, column or map (anything with data(), size()
+	/// and innerStride()), eg a row of a column-major array.  The
+	/// viewed memory must outlive the span.  A mutable span may
+	/// only view mutable memory but, as with Eigen's own idiom for
+	/// writing into block expressions, that may be reached through
+	/// a temporary such as arr.row(irow) of a non-const arr.
+	template<typename Val>
+	class Span {
+	public:
+	    typedef typename std::remove_const<Val>::type value_type;
+
+	    Span(Val* data, size_t size, size_t stride=1)
+		: m_data(data), m_size(size), m_stride(stride) {}
+
+	    /// A read-only span from a mutable one.
+	    template<typename Other, typename = typename std::enable_if<
+					 std::is_same<const Other, Val>::value>::type>
+	    Span(const Span<Other>& other)
+		: m_data(other.data()), m_size(other.size()), m_stride(other.stride()) {}
+
+	    template<typename Alloc>
+	    Span(std::vector<value_type, Alloc>& vec)
+		: m_data(vec.data()), m_size(vec.size()), m_stride(1) {}
+
+	    /// Only read-only spans view a const vector.
+	    template<typename Alloc, typename V = Val,
+		     typename = typename std::enable_if<std::is_const<V>::value>::type>
+	    Span(const std::vector<value_type, Alloc>& vec)
+		: m_data(vec.data()), m_size(vec.size()), m_stride(1) {}
+
+	    /// Any Eigen dense object whose data() may be viewed as
+	    /// Val, so const objects give only read-only spans.
+	    template<typename Dense,
+		     typename = decltype(std::declval<Dense&>().innerStride()),
+		     typename = typename std::enable_if<std::is_convertible<
+			 decltype(std::declval<Dense&>().data()), Val*>::value>::type>
+	    Span(Dense&& dense)
+		: m_data(dense.data())
+		, m_size(dense.size()), m_stride(dense.innerStride()) {}
+
+	    Val* data() const { return m_data; }
+	    size_t size() const { return m_size; }
+	    size_t stride() const { return m_stride; }
+	    Val& operator[](size_t ind) const { return m_data[ind*m_stride]; }
+
+	private:
+	    Val* m_data;
+	    size_t m_size, m_stride;
+	};
+
 
 	/// A half-open range of bins (from first bin to one past last bin)
 	typedef std::pair<int,int> BinRange;
@@ -40,7 +96,8 @@ namespace WireCell {
 	/// A list of bin ranges.
 	typedef std::vector<BinRange> BinRangeList;
 
-	/// Return a new list with any overlaps formed into unions.
+	/// Return a new list with any overlaps formed into unions.  See
+	/// BinRangeSet.h for a flat set type with more operations.
 	BinRangeList merge(const BinRangeList& br);
 
 	/// Merge two bin range lists, forming a union from any overlapping ranges
@@ -87,7 +144,8 @@ namespace WireCell {
 	    
 	/// Return a new sequence resampled and interpolated from the
 	/// original wave defined over the domain to a new domain of
-	/// nsamples.
+	/// nsamples.  See Resampler for repeated use and for linear
+	/// weights that fall off with the distance to each neighbor.
 	template<typename Val>
 	Sequence<Val> resample(const Sequence<Val>& wave, const Domain& domain, int nsamples, const Domain& newdomain) {
 	    const int oldnsamples = wave.size();
@@ -114,6 +172,126 @@ namespace WireCell {
 	    return ret;
 	}
 
+	/** Resample many waves between the same two samplings.
+
+	    Built once for a wave of nsamples over domain going to
+	    newnsamples over newdomain.  Sample i of a domain is at its
+	    start plus i sample widths and values outside the original
+	    domain are those at its ends.  Each output sample is a fixed
+	    weighted sum of neighboring input samples and the start
+	    index and weights of every output sample are computed up
+	    front, so applying it is a gather and a short dot product.
+
+	    Resampler rs(fr_domain, fr_n, tick_domain, tick_n,
+	                 Resampler::bandlimited);
+	    auto out = rs(wave);
+	    rs.rows(frame, out_frame);   // each row of 2D arrays
+
+	    The modes are:
+
+	    - linear :: interpolation between the two nearest samples,
+	      each weighted by its closeness.  This differs from the
+	      weighting resample() has always used.
+
+	    - cubic :: Catmull-Rom interpolation over four samples,
+	      exact for quadratics.
+
+	    - bandlimited :: a Blackman windowed sinc spanning
+	      sinc_lobes zero crossings each side.  When downsampling,
+	      the sinc is stretched to cut off at the new Nyquist
+	      frequency so content above it is suppressed rather than
+	      aliased.  Weights are normalized so constants are kept.
+
+	    A ValueError is thrown for empty samplings or mismatched
+	    wave or output sizes.  Rows are spread over
+	    Parallel::nthreads().
+	 */
+	class Resampler {
+	public:
+	    enum Mode { linear, cubic, bandlimited };
+	    static const int sinc_lobes = 8;
+
+	    Resampler(const Domain& domain, size_t nsamples,
+		      const Domain& newdomain, size_t newnsamples,
+		      Mode mode=linear);
+
+	    Mode mode() const { return m_mode; }
+	    size_t input_size() const { return m_nin; }
+	    size_t size() const { return m_nout; }
+
+	    /// Number of input samples contributing to each output.
+	    size_t ntaps() const { return m_ntaps; }
+
+	    /// Resample one wave into out.
+	    void operator()(Span<const real_t> wave, Span<real_t> out) const;
+	    realseq_t operator()(Span<const real_t> wave) const;
+
+	    /// Resample each row of one 2D Eigen array (or block or
+	    /// map) into the same row of another of size() columns.
+	    /// This sweeps whole columns, each output column being the
+	    /// weighted sum of ntaps() input columns, so a column-major
+	    /// array is read and written contiguously and only the
+	    /// input columns in use are read.  A ValueError is thrown if
+	    /// the shapes do not match.
+	    template<typename ArrayIn, typename ArrayOut>
+	    void rows(const ArrayIn& in, ArrayOut& out) const {
+		check_rows(in.rows(), in.cols(), out.rows(), out.cols());
+		Parallel::for_range(in.rows(), [&](int beg, int end) {
+		    // whole chunks, fixed size so that they vectorize
+		    const int nwhole = (end - beg) / chunk_rows * chunk_rows;
+		    sweep<chunk_rows>(in, out, beg, nwhole);
+		    sweep<1>(in, out, beg + nwhole, end - beg - nwhole);
+		});
+	    }
+
+	    static const int chunk_rows = 32;
+
+	private:
+	    void check_rows(size_t nrows_in, size_t ncols_in, size_t nrows_out, size_t ncols_out) const;
+
+	    // Fill output rows [row0, row0+nrows), a multiple of nchunk,
+	    // column by column and nchunk rows at a time.
+	    template<int nchunk, typename ArrayIn, typename ArrayOut>
+	    void sweep(const ArrayIn& in, ArrayOut& out, int row0, int nrows) const {
+		const int last = m_nin - 1;
+		// Rows are strided by rowStride(), one in column-major.
+		const int istride = in.rowStride(), ostride = out.rowStride();
+		for (size_t iout = 0; iout < m_nout; ++iout) {
+		    const real_t* w = m_weights.data() + iout*m_ntaps;
+		    for (int irow = row0; irow < row0 + nrows; irow += nchunk) {
+			real_t acc[nchunk] = {0};
+			for (size_t itap = 0; itap < m_ntaps; ++itap) {
+			    const int icol = std::max(0, std::min(m_first[iout] + int(itap), last));
+			    const real_t* col = &in(irow, icol);
+			    if (istride == 1) {
+				for (int ind = 0; ind < nchunk; ++ind) {
+				    acc[ind] += w[itap]*col[ind];
+				}
+			    }
+			    else {
+				for (int ind = 0; ind < nchunk; ++ind) {
+				    acc[ind] += w[itap]*col[ind*istride];
+				}
+			    }
+			}
+			real_t* ocol = &out(irow, iout);
+			for (int ind = 0; ind < nchunk; ++ind) {
+			    ocol[ind*ostride] = acc[ind];
+			}
+		    }
+		}
+	    }
+
+	    Mode m_mode;
+	    size_t m_nin, m_nout, m_ntaps;
+	    // Output i is the dot product of weights [i*ntaps, (i+1)*ntaps)
+	    // with the input starting at index m_first[i], clamped to
+	    // the ends for outputs outside [m_ibeg, m_iend).
+	    size_t m_ibeg, m_iend;
+	    std::vector<int> m_first;
+	    realseq_t m_weights;
+	};
+
 	/// Return the real part of the sequence
 	realseq_t real(const compseq_t& seq);
 	/// Return the imaginary part of the sequence
@@ -168,7 +346,8 @@ namespace WireCell {
         /// Return a pair of indices into wave which bound non-zero
         /// region.  First index is of first non-zero sample, second
         /// index is one past last non-zero sample.  If entire wave is
-        /// empty then both are set to size().
+        /// empty then both are set to size().  See SparseWave in
+        /// SparseWaveform.h to keep each non-zero region.
         std::pair<int, int> edge(const realseq_t& wave);
             
 
@@ -189,7 +368,9 @@ namespace WireCell {
 	}
 	
 	// Return the mean and (population) RMS over a waveform signal.
+	// This is a single pass over the float samples in place.
 	std::pair<double,double> mean_rms(const realseq_t& wave);
+	std::pair<double,double> mean_rms(Span<const real_t> wave);
 	
 	
 	// Return the median value.  This is rather slow as it
@@ -203,6 +384,121 @@ namespace WireCell {
 	real_t percentile(realseq_t wave, real_t percentage);
 	real_t percentile_binned(realseq_t& wave, real_t percentage);
 
+	/** Selection-based median and percentiles.
+
+	    These give exactly what median() and percentile() give,
+	    the element at index size*percentage of the sorted wave,
+	    but by partial selection in linear time.  The realseq_t
+	    forms reorder wave in place, so pass a scratch copy if the
+	    order matters.  The span forms copy into per-thread scratch
+	    and leave their input alone.  The index is clamped to the
+	    last element.  An empty wave gives zero.
+
+	    percentiles() returns one value per requested percentage,
+	    in the order given, from a single pass of nested
+	    selections:
+
+	    auto qs = percentiles(scratch, {0.1, 0.5, 0.9});
+	 */
+	real_t median_select(realseq_t& wave);
+	real_t median_select(Span<const real_t> wave);
+	real_t percentile_select(realseq_t& wave, real_t percentage);
+	real_t percentile_select(Span<const real_t> wave, real_t percentage);
+	std::vector<real_t> percentiles(realseq_t& wave, const std::vector<real_t>& percentages);
+	std::vector<real_t> percentiles(Span<const real_t> wave, const std::vector<real_t>& percentages);
+
+	/** A histogram of one wave answering many quantile queries.
+
+	    Fill once per wave, then ask for any number of quantiles.
+	    The nbins bins span the wave's [min, max] range, nbins=0
+	    meaning one bin per sample as percentile_binned() uses.
+	    The histogram memory is kept across fills.
+
+	    QuantileHistogram qh;
+	    qh.fill(wave);
+	    auto med = qh.quantile(0.5);
+	    auto exact = qh.quantile(0.9, true);
+
+	    Values are binned by rounding, as percentile_binned() always
+	    has, so bin i is centered on min + i*(max-min)/nbins.  A
+	    binned answer is the center of the bin holding the element
+	    percentile() would return.  It is within half a bin width
+	    of it, or one width in the last bin, which also takes the
+	    values above its center up to max.  Refined answers rescan the
+	    wave for the values in that bin alone and select the exact
+	    element, equal to percentile().  The wave is viewed, not
+	    copied, so it must be kept unchanged until the queries are
+	    done.
+	 */
+	class QuantileHistogram {
+	public:
+	    QuantileHistogram(size_t nbins=0);
+
+	    void fill(Span<const real_t> wave);
+
+	    real_t quantile(real_t percentage, bool refine=false) const;
+	    std::vector<real_t> quantiles(const std::vector<real_t>& percentages,
+					  bool refine=false) const;
+
+	    /// The bin width of the current fill.
+	    real_t binsize() const { return m_binsize; }
+
+	private:
+	    int bin(real_t val) const;
+
+	    size_t m_nbins;
+	    Span<const real_t> m_wave;
+	    real_t m_vmin, m_vmax, m_binsize;
+	    std::vector<int> m_cumulative; // counts up to and including each bin
+	};
+
+	/** Rolling median or other percentile over sliding windows.
+
+	    One value is produced for each center at sample 0,
+	    stride, 2*stride, ... below the wave size.  It is the
+	    percentile(), as defined above, of the window of the
+	    given width starting width/2 samples before the center,
+	    clipped to the wave.  So windows shrink near the ends.
+
+	    RollingQuantile rq(window, stride);   // median by default
+	    auto baseline = rq(wave);             // rq.size(wave.size()) values
+	    rq.rows(frame, out);                  // each row of a 2D array
+
+	    Overlapping windows are updated incrementally as the
+	    window slides, costing O(log window) per sample, instead
+	    of selecting each from scratch.  Rows are spread over
+	    Parallel::nthreads().  A ValueError is thrown for a zero
+	    window or stride or a wrongly sized output.
+	 */
+	class RollingQuantile {
+	public:
+	    RollingQuantile(size_t window, size_t stride=1, real_t percentage=0.5);
+
+	    /// Number of values produced for a wave of nsamples.
+	    size_t size(size_t nsamples) const {
+		return (nsamples + m_stride - 1) / m_stride;
+	    }
+
+	    void operator()(Span<const real_t> wave, Span<real_t> out) const;
+	    realseq_t operator()(Span<const real_t> wave) const;
+
+	    /// Process each row of a 2D (eg Eigen) array into the
+	    /// same row of out which is resized as needed.
+	    template<typename In2D, typename Out2D>
+	    void rows(const In2D& frame, Out2D& out) const {
+		out.resize(frame.rows(), size(frame.cols()));
+		Parallel::for_range(frame.rows(), [&](int beg, int end) {
+		    for (int irow = beg; irow < end; ++irow) {
+			(*this)(frame.row(irow), out.row(irow));
+		    }
+		});
+	    }
+
+	private:
+	    size_t m_window, m_stride;
+	    real_t m_percentage;
+	};
+
 	/// Discrete Fourier transform of real sequence.  Returns full
 	/// spectrum.  No normalization scaling applied
 	compseq_t dft(realseq_t seq);
@@ -229,8 +525,170 @@ namespace WireCell {
 	/// 1/Nsamples normalization.
 	realseq_t idft(compseq_t spec);
 
+	/** Half-spectrum transforms of real sequences.
+
+	    The spectrum of a real sequence is Hermitian so only its
+	    first N/2+1 bins, up to and including Nyquist, are
+	    needed.  rfft() returns those bins of dft() and irfft()
+	    inverts them given the number of samples, which the bin
+	    count alone does not determine.  Filters may be sampled on
+	    the same grid with Response::Generator::half_spectrum().
+
+	    auto spec = rfft(wave);         // wave.size()/2+1 bins
+	    // ... filter ...
+	    auto wave2 = irfft(spec, wave.size());
+	 */
+	compseq_t rfft(const realseq_t& wave);
+	realseq_t irfft(const compseq_t& spec, int nsamples);
+
+	/// Span forms of rfft() and irfft().  The spectrum must have
+	/// wave.size()/2+1 bins or a ValueError is thrown.
+	void rfft(Span<const real_t> wave, Span<complex_t> spec);
+	void irfft(Span<const complex_t> spec, Span<real_t> wave);
+
+	/** Transforms and convolutions over spans.
+
+	    These read their input in place and write into caller
+	    owned output, so processing many channels copies nothing
+	    and, once warmed up, allocates nothing:
+
+	    dft(arr.row(irow), spec);      // spec sized arr.cols()
+	    linear_convolve(wave, resp, out);
+
+	    The dft() spectrum and idft() wave must be as long as
+	    their input.  Convolutions write the first out.size()
+	    samples of what the corresponding function above returns
+	    untruncated.  So out.size() equal to the first input's
+	    size gives the truncated result.  A ValueError is thrown
+	    on a size mismatch.  Unlike the sequence form, which
+	    gives inf or NaN, the span replace_convolve() zeroes
+	    frequency bins where the old response vanishes.
+	 */
+	void dft(Span<const real_t> wave, Span<complex_t> spec);
+	void idft(Span<const complex_t> spec, Span<real_t> wave);
+	void linear_convolve(Span<const real_t> in1, Span<const real_t> in2,
+			     Span<real_t> out);
+	void replace_convolve(Span<const real_t> wave, Span<const real_t> newres,
+			      Span<const real_t> oldres, Span<real_t> out);
+
+	/** Linear convolution of many signals with one kernel.
+
+	    Build once from the kernel, eg an electronics response,
+	    and the longest signal to be convolved.  The kernel
+	    spectrum is computed once so each signal then costs one
+	    forward and one inverse transform instead of the two
+	    forward and one inverse of linear_convolve().  Results
+	    equal linear_convolve() to rounding.
+
+	    Convolver conv(resp, nticks);
+	    conv(wave, out);            // out.size() <= wave.size()+resp.size()-1
+	    conv(waves, outs);          // batch, truncated as by default below
+	    conv.rows(frame);           // each row of a 2D array in place
+
+	    A const Convolver may be used from many threads.  Batches
+	    are spread over Parallel::nthreads().  A ValueError is
+	    thrown if a signal is longer than the maximum or an output
+	    longer than the full convolution.
+	 */
+	class Convolver {
+	public:
+	    Convolver(Span<const real_t> kernel, size_t max_size);
+
+	    size_t kernel_size() const { return m_nkern; }
+	    size_t max_size() const { return m_nmax; }
+
+	    /// The transform length used.
+	    size_t fft_size() const { return m_nfft; }
+
+	    /// Convolve one signal into out.
+	    void operator()(Span<const real_t> signal, Span<real_t> out) const;
+
+	    /// Return the convolution, truncated to the signal size
+	    /// unless truncate is false, as linear_convolve().
+	    realseq_t operator()(Span<const real_t> signal, bool truncate=true) const;
+
+	    /// Convolve a batch.  Outputs are resized as needed.
+	    void operator()(const std::vector<realseq_t>& signals,
+			    std::vector<realseq_t>& outs, bool truncate=true) const;
+
+	    /// Convolve each row of a 2D (eg Eigen) array in place,
+	    /// truncated to the row length.
+	    template<typename Array2D>
+	    void rows(Array2D& frame) const {
+		Parallel::for_range(frame.rows(), [&](int beg, int end) {
+		    for (int irow = beg; irow < end; ++irow) {
+			(*this)(frame.row(irow), frame.row(irow));
+		    }
+		});
+	    }
+
+	protected:
+	    // For subclasses which fill m_spec themselves.
+	    Convolver(size_t kernel_size, size_t max_size);
+
+	    size_t m_nkern, m_nmax, m_nfft;
+	    compseq_t m_spec;   // half spectrum of the kernel
+	};
+
+	/** Replace one response with another in many signals.
+
+	    The cached equivalent of replace_convolve() for responses
+	    shared by every channel of a plane.  The spectral ratio
+	    newres/oldres is computed once so each signal costs one
+	    forward and one inverse transform.  The interface is that
+	    of Convolver (single, batch and 2D array rows) with a
+	    kernel of the larger response's size.
+
+	    With regularization r > 0 the ratio is taken as
+
+	        N conj(O) / (|O|^2 + r max|O|^2)
+
+	    which tames bins where the old response O nearly
+	    vanishes.  Bins where the denominator vanishes, with
+	    r = 0 or an all-zero O, are zeroed.
+
+	    The transform length is chosen once from max_size so
+	    results match replace_convolve() exactly only when the old
+	    response divides out cleanly.
+	 */
+	class ResponseReplacer : public Convolver {
+	public:
+	    ResponseReplacer(Span<const real_t> newres, Span<const real_t> oldres,
+			     size_t max_size, real_t regularization=0);
+	};
+
+	/// Precision-generic dft() and idft(), instantiated for
+	/// float and double, which do not copy their input.
+	template<typename Real>
+	Sequence<std::complex<Real> > dft(const Sequence<Real>& seq);
+	template<typename Real>
+	Sequence<Real> idft(const Sequence<std::complex<Real> >& spec);
+
+	/// How to fill samples appended to a sequence.  Zero padding
+	/// appends zeros.  Reflection mirrors the sequence about its
+	/// last sample (excluding it) and bounces back and forth if
+	/// more samples are needed.
+	enum PadType { pad_zero, pad_reflect };
+
+	/// Return a copy of the wave extended to nsamples.  If wave
+	/// is already that long it is returned unchanged.
+	realseq_t pad(const realseq_t& wave, int nsamples, PadType type = pad_zero);
+
+	/// Discrete Fourier transform after padding the wave to the
+	/// FFT-friendly length given by fft_best_length().  The
+	/// number of samples added is returned in npad.  The
+	/// spectrum has wave.size()+npad bins.
+	compseq_t dft_padded(const realseq_t& wave, int& npad, PadType type = pad_zero);
+
+	/// Inverse of dft_padded(): inverse transform the spectrum
+	/// and crop npad samples from the end.  A ValueError is
+	/// thrown unless 0 <= npad <= spec.size().
+	realseq_t idft_cropped(const compseq_t& spec, int npad);
+
 	/// Return the smallest, most frequent value to appear in vector.
+	/// Ties go to the value smallest when taken as unsigned.
 	short most_frequent(const std::vector<short>& vals);
+	short most_frequent(Span<const short> vals);
 
     }
 }
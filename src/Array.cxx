@@ -1,229 +1,953 @@
 #include "WireCellUtil/Array.h"
-
-#include <unsupported/Eigen/FFT>
+#include "WireCellUtil/ComplexKernels.h"
+#include "WireCellUtil/Exceptions.h"
+#include "WireCellUtil/FFTBestLength.h"
+#include "WireCellUtil/FFTPlanCache.h"
+#include "WireCellUtil/Parallel.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <complex>
+#include <vector>
 
 using namespace WireCell;
 using namespace WireCell::Array;
 
 
+// All transforms go through the per-thread plan cache.  The helpers
+// below transform every row or every column of their input into the
+// same row or column of the output which may be the input itself.
+// Rows (columns) are split across the default number of threads.
+//
+// Eigen arrays are column-major so columns are contiguous and rows
+// are strided.  Unless disabled, the row passes transpose blocks of
+// rows into row-major tiles, transform the now contiguous rows and
+// transpose the results back.  Each cache line read or written then
+// serves a whole block of rows instead of one element of one row.
 
-//http://stackoverflow.com/a/33636445
+static std::atomic<int> g_row_block(16);
 
-WireCell::Array::array_xxc WireCell::Array::dft(const WireCell::Array::array_xxf& arr)
+void WireCell::Array::set_row_block(int nrows)
 {
-    const int nrows = arr.rows();
-    const int ncols = arr.cols();
+    g_row_block = std::max(0, nrows);
+}
 
-    Eigen::FFT< float > fft;
-    Eigen::MatrixXcf matc(nrows, ncols);
+int WireCell::Array::row_block()
+{
+    return g_row_block;
+}
 
-    for (int irow = 0; irow < nrows; ++irow) {
-        Eigen::VectorXcf fspec(ncols); // frequency spectrum 
-	// fft wants vectors, also input arr is const
-	Eigen::VectorXf tmp = arr.row(irow);
-	fft.fwd(fspec, tmp);
-        matc.row(irow) = fspec;
+typedef FFTPlanCache::real_t real_t;
+typedef FFTPlanCache::complex_t complex_t;
+
+enum Op { op_fwd, op_inv, op_rfwd, op_rinv };
+
+template<typename T>
+static void apply(FFTPlanCache& fft, Op op, std::complex<T>* out, int ostride,
+                  const T* in, int istride, int n)
+{
+    if (op == op_rfwd) { fft.rfwd(out, ostride, in, istride, n); }
+    else               { fft.fwd(out, ostride, in, istride, n); }
+}
+template<typename T>
+static void apply(FFTPlanCache& fft, Op op, T* out, int ostride,
+                  const std::complex<T>* in, int istride, int n)
+{
+    if (op == op_rinv) { fft.rinv(out, ostride, in, istride, n); }
+    else               { fft.inv(out, ostride, in, istride, n); }
+}
+template<typename T>
+static void apply(FFTPlanCache& fft, Op op, std::complex<T>* out, int ostride,
+                  const std::complex<T>* in, int istride, int n)
+{
+    if (op == op_inv) { fft.inv(out, ostride, in, istride, n); }
+    else              { fft.fwd(out, ostride, in, istride, n); }
+}
+
+// Per-thread tile buffer.  Slot distinguishes input and output tiles
+// of the same type.
+template<typename T, int slot>
+static T* tile(size_t size)
+{
+    static thread_local std::vector<T, Eigen::aligned_allocator<T> > buf;
+    if (buf.size() < size) {
+        buf.resize(size);
+    }
+    return buf.data();
+}
+
+// If sel is given only the rows it lists are transformed and the
+// other rows of out are left untouched.
+template<typename Out, typename In>
+static void row_pass(Out& out, const In& in, Op op, const std::vector<int>* sel = nullptr)
+{
+    typedef typename Out::Scalar out_t;
+    typedef typename In::Scalar in_t;
+    const int nrows = sel ? sel->size() : in.rows();
+    const int nin = in.cols();
+    const int nout = out.cols();
+    const int nfft = std::max(nin, nout);
+    const int nblock = g_row_block;
+    if (nrows == 0 || nfft == 0) {
+        return;
+    }
+    auto rowof = [&](int ind) { return sel ? (*sel)[ind] : ind; };
+    // The spectrum of no samples is zero.  Going through the n=1
+    // identity would read from an empty row.
+    if (nin == 0 || nout == 0) {
+        for (int ind = 0; ind < nrows; ++ind) {
+            out.row(rowof(ind)).setZero();
+        }
+        return;
     }
 
-    for (int icol = 0; icol < ncols; ++icol) {
-        Eigen::VectorXcf pspec(nrows); // periodicity spectrum
-        fft.fwd(pspec, matc.col(icol));
-        matc.col(icol) = pspec;
+    if (nblock <= 1) {          // gather each strided row by itself
+        Parallel::for_range(nrows, [&](int beg, int end) {
+            auto& fft = FFTPlanCache::local();
+            for (int ind = beg; ind < end; ++ind) {
+                const int irow = rowof(ind);
+                apply(fft, op, &out(irow,0), out.rows(), &in(irow,0), in.rows(), nfft);
+            }
+        });
+        return;
     }
 
-    return matc;
+    const int nblocks = (nrows + nblock - 1) / nblock;
+    Parallel::for_range(nblocks, [&](int beg, int end) {
+        auto& fft = FFTPlanCache::local();
+        in_t* tin = tile<in_t, 0>(nblock*nin);
+        out_t* tout = tile<out_t, 1>(nblock*nout);
+        for (int iblock = beg; iblock < end; ++iblock) {
+            const int ind0 = iblock*nblock;
+            const int nr = std::min(nblock, nrows - ind0);
+            const int row0 = rowof(ind0);
+            // selected rows are often in runs
+            const bool scattered = sel && rowof(ind0+nr-1) - row0 != nr-1;
+
+            if (scattered) {
+                for (int icol = 0; icol < nin; ++icol) {
+                    for (int ind = 0; ind < nr; ++ind) {
+                        tin[ind*nin + icol] = in(rowof(ind0+ind), icol);
+                    }
+                }
+            }
+            else {
+                for (int icol = 0; icol < nin; ++icol) {
+                    const in_t* col = &in(row0, icol);
+                    for (int ind = 0; ind < nr; ++ind) {
+                        tin[ind*nin + icol] = col[ind];
+                    }
+                }
+            }
+            for (int ind = 0; ind < nr; ++ind) {
+                apply(fft, op, tout + ind*nout, 1, tin + ind*nin, 1, nfft);
+            }
+            if (scattered) {
+                for (int icol = 0; icol < nout; ++icol) {
+                    for (int ind = 0; ind < nr; ++ind) {
+                        out(rowof(ind0+ind), icol) = tout[ind*nout + icol];
+                    }
+                }
+            }
+            else {
+                for (int icol = 0; icol < nout; ++icol) {
+                    out_t* col = &out(row0, icol);
+                    for (int ind = 0; ind < nr; ++ind) {
+                        col[ind] = tout[ind*nout + icol];
+                    }
+                }
+            }
+        }
+    });
 }
 
-WireCell::Array::array_xxc WireCell::Array::dft_rc(const WireCell::Array::array_xxf& arr, int dim)
+// Forward row pass straight from ADC counts.  Each tile column is
+// converted to float and pedestal subtracted as a contiguous run
+// before being scattered into the row-major tile.
+static void adc_rows(array_xxc& out, const array_xxs& adc, const float* ped, Op op)
 {
-    const int nrows = arr.rows();
-    const int ncols = arr.cols();
+    const int nrows = adc.rows();
+    const int nin = adc.cols();
+    const int nout = out.cols();
+    if (nin == 0) {
+        out.setZero();
+        return;
+    }
+    if (nrows == 0) {
+        return;
+    }
+    const int nblock = std::max(1, (int)g_row_block);
+    const int nblocks = (nrows + nblock - 1) / nblock;
+    Parallel::for_range(nblocks, [&](int beg, int end) {
+        auto& fft = FFTPlanCache::local();
+        real_t* tin = tile<real_t, 0>(nblock*nin);
+        complex_t* tout = tile<complex_t, 1>(nblock*nout);
+        real_t* conv = tile<real_t, 2>(nblock);
+        for (int iblock = beg; iblock < end; ++iblock) {
+            const int row0 = iblock*nblock;
+            const int nr = std::min(nblock, nrows - row0);
+            const float* rped = ped + row0;
+
+            for (int icol = 0; icol < nin; ++icol) {
+                const short* col = &adc(row0, icol);
+                for (int ind = 0; ind < nr; ++ind) {
+                    conv[ind] = col[ind] - rped[ind];
+                }
+                for (int ind = 0; ind < nr; ++ind) {
+                    tin[ind*nin + icol] = conv[ind];
+                }
+            }
+            for (int ind = 0; ind < nr; ++ind) {
+                apply(fft, op, tout + ind*nout, 1, tin + ind*nin, 1, nin);
+            }
+            for (int icol = 0; icol < nout; ++icol) {
+                complex_t* col = &out(row0, icol);
+                for (int ind = 0; ind < nr; ++ind) {
+                    col[ind] = tout[ind*nout + icol];
+                }
+            }
+        }
+    });
+}
+
+template<typename Out, typename In>
+static void col_pass(Out& out, const In& in, Op op)
+{
+    if (in.rows() == 0) {
+        return;
+    }
+    Parallel::for_range(in.cols(), [&](int beg, int end) {
+        auto& fft = FFTPlanCache::local();
+        for (int icol = beg; icol < end; ++icol) {
+            apply(fft, op, &out(0,icol), 1, &in(0,icol), 1, in.rows());
+        }
+    });
+}
 
-    Eigen::FFT< float > fft;
-    Eigen::MatrixXcf matc(nrows, ncols);
+template<typename Out, typename In>
+static void fwd_rows(Out& out, const In& in) { row_pass(out, in, op_fwd); }
+static void fwd_rows(array_xxc& out, const array_xxf& in, const std::vector<int>& sel)
+{
+    out.setZero();
+    row_pass(out, in, op_fwd, &sel);
+}
+static void rfwd_rows(array_xxc& out, const array_xxf& in, const std::vector<int>& sel)
+{
+    out.setZero();
+    row_pass(out, in, op_rfwd, &sel);
+}
+template<typename Out, typename In>
+static void inv_rows(Out& out, const In& in) { row_pass(out, in, op_inv); }
+template<typename Out, typename In>
+static void fwd_cols(Out& out, const In& in) { col_pass(out, in, op_fwd); }
+template<typename Out, typename In>
+static void inv_cols(Out& out, const In& in) { col_pass(out, in, op_inv); }
+template<typename Out, typename In>
+static void rfwd_rows(Out& out, const In& in) { row_pass(out, in, op_rfwd); }
+template<typename Out, typename In>
+static void rinv_rows(Out& out, const In& in) { row_pass(out, in, op_rinv); }
+
+
+template<typename Real>
+WireCell::Array::array_xxz<Real> WireCell::Array::dft(const WireCell::Array::array_xxr<Real>& arr)
+{
+    array_xxz<Real> ret;
+    dft(arr, ret);
+    return ret;
+}
+
+template<typename Real>
+void WireCell::Array::dft(const WireCell::Array::array_xxr<Real>& arr, WireCell::Array::array_xxz<Real>& spec)
+{
+    spec.resize(arr.rows(), arr.cols());
+    fwd_rows(spec, arr);        // frequency spectrum
+    fwd_cols(spec, spec);       // periodicity spectrum
+}
 
+WireCell::Array::array_xxc WireCell::Array::dft(const WireCell::Array::array_xxf& arr)
+{
+    return dft<float>(arr);
+}
+
+void WireCell::Array::dft(const WireCell::Array::array_xxf& arr, WireCell::Array::array_xxc& spec)
+{
+    dft<float>(arr, spec);
+}
+
+WireCell::Array::array_xxc WireCell::Array::dft_rc(const WireCell::Array::array_xxf& arr, int dim)
+{
+    array_xxc ret(arr.rows(), arr.cols());
     if (dim == 0) {
-        for (int irow = 0; irow < nrows; ++irow) {
-            Eigen::VectorXcf fspec(ncols);
-            Eigen::VectorXf tmp = arr.row(irow);
-            fft.fwd(fspec, tmp);
-            matc.row(irow) = fspec;
-        }
+        fwd_rows(ret, arr);
     }
     else if (dim == 1) {
-        for (int icol = 0; icol < ncols; ++icol) {
-            Eigen::VectorXcf fspec(nrows);
-            Eigen::VectorXf tmp = arr.col(icol);
-            fft.fwd(fspec, tmp);
-            matc.col(icol) = fspec;
-        }
-    }        
-    return matc;
+        fwd_cols(ret, arr);
+    }
+    return ret;
 }
 
 WireCell::Array::array_xxc WireCell::Array::dft_cc(const WireCell::Array::array_xxc& arr, int dim)
 {
-    const int nrows = arr.rows();
-    const int ncols = arr.cols();
-
-    Eigen::FFT< float > fft;
-    Eigen::MatrixXcf matc(nrows, ncols);
-
-    matc = arr.matrix();
-    
+    array_xxc ret(arr.rows(), arr.cols());
     if (dim == 0) {
-        for (int irow = 0; irow < nrows; ++irow) {
-            Eigen::VectorXcf pspec(ncols);
-            fft.fwd(pspec,matc.row(irow));
-            matc.row(irow) = pspec;
-        }
+        fwd_rows(ret, arr);
     }
     else {
-        for (int icol = 0; icol < ncols; ++icol) {
-            Eigen::VectorXcf pspec(nrows);
-            fft.fwd(pspec, matc.col(icol));
-            matc.col(icol) = pspec;
-        }
+        fwd_cols(ret, arr);
     }
-    return matc;
+    return ret;
 }
 
+template<typename Real>
+WireCell::Array::array_xxr<Real> WireCell::Array::idft(const WireCell::Array::array_xxz<Real>& arr)
+{
+    // don't step on const input
+    array_xxz<Real> partial(arr.rows(), arr.cols());
+    inv_cols(partial, arr);     // wire spectrum
 
+    array_xxr<Real> ret(arr.rows(), arr.cols());
+    inv_rows(ret, partial);     // back to real-valued time series
+    return ret;
+}
+
+template<typename Real>
+void WireCell::Array::idft(WireCell::Array::array_xxz<Real>& spec, WireCell::Array::array_xxr<Real>& arr)
+{
+    inv_cols(spec, spec);
+    arr.resize(spec.rows(), spec.cols());
+    inv_rows(arr, spec);
+}
 
 WireCell::Array::array_xxf WireCell::Array::idft(const WireCell::Array::array_xxc& arr)
 {
-    const int nrows = arr.rows();
-    const int ncols = arr.cols();
+    return idft<float>(arr);
+}
 
-    // fft works on matrices, not arrays, also don't step on const input
-    Eigen::MatrixXcf partial(nrows, ncols);
-    partial = arr.matrix();
+void WireCell::Array::idft(WireCell::Array::array_xxc& spec, WireCell::Array::array_xxf& arr)
+{
+    idft<float>(spec, arr);
+}
 
-    Eigen::FFT< float > fft;
+WireCell::Array::array_xxc WireCell::Array::idft_cc(const WireCell::Array::array_xxc& arr, int dim)
+{
+    array_xxc ret(arr.rows(), arr.cols());
+    if (dim == 1) {
+        inv_cols(ret, arr);
+    }
+    else if (dim == 0) {
+        inv_rows(ret, arr);
+    }
+    return ret;
+}
 
-    for (int icol = 0; icol < ncols; ++icol) {
-        Eigen::VectorXcf pspec(nrows); // wire spectrum
-        fft.inv(pspec, partial.col(icol));
-        partial.col(icol) = pspec;
+WireCell::Array::array_xxf WireCell::Array::idft_cr(const WireCell::Array::array_xxc& arr, int dim)
+{
+    array_xxf ret(arr.rows(), arr.cols());
+    if (dim == 0) {
+        inv_rows(ret, arr);
+    }
+    else if (dim == 1) {
+        inv_cols(ret, arr);
     }
+    return ret;
+}
 
-    //shared_array_xxf ret = std::make_shared<array_xxf> (nrows, ncols);
-    array_xxf ret(nrows, ncols);
 
-    for (int irow = 0; irow < nrows; ++irow) {
-        Eigen::VectorXf wave(ncols); // back to real-valued time series
-        fft.inv(wave, partial.row(irow));
-        ret.row(irow) = wave;
+template<typename Real>
+WireCell::Array::array_xxr<Real>
+WireCell::Array::deconv(const WireCell::Array::array_xxr<Real>& arr,
+			const WireCell::Array::array_xxz<Real>& filter)
+{
+    array_xxr<Real> ret = arr;
+    BasicWorkspace<Real> ws;
+    deconv(ret, filter, ws);
+    return ret;
+}
+
+WireCell::Array::array_xxf
+WireCell::Array::deconv(const WireCell::Array::array_xxf& arr,
+			const WireCell::Array::array_xxc& filter)
+{
+    return deconv<float>(arr, filter);
+}
+
+template<typename Complex>
+static void assert_filter_shape(const Complex& filter, int nrows, int ncols)
+{
+    if (filter.rows() != nrows || filter.cols() != ncols) {
+        THROW(ValueError() << errmsg{"deconvolution filter shape does not match its array"});
     }
+}
 
+// Multiply spectrum by a filter of the same shape, in place.
+template<typename Complex>
+static void apply_filter(Complex& spec, const Complex& filter)
+{
+    ComplexKernels::multiply(spec.data(), spec.data(), filter.data(), spec.size());
+}
+
+// Forward, filter and inverse in one working array to avoid temporaries.
+template<typename Real>
+void WireCell::Array::deconv(WireCell::Array::array_xxr<Real>& arr,
+                             const WireCell::Array::array_xxz<Real>& filter,
+                             WireCell::Array::BasicWorkspace<Real>& ws)
+{
+    assert_filter_shape(filter, arr.rows(), arr.cols());
+
+    array_xxz<Real>& work = ws.spec;
+    work.resize(arr.rows(), arr.cols());
+    fwd_rows(work, arr);
+    fwd_cols(work, work);
+
+    // deconvolution via multiplication in frequency space
+    apply_filter(work, filter);
+
+    inv_cols(work, work);
+    inv_rows(arr, work);
+}
+
+void WireCell::Array::deconv(WireCell::Array::array_xxf& arr,
+                             const WireCell::Array::array_xxc& filter,
+                             WireCell::Array::Workspace& ws)
+{
+    deconv<float>(arr, filter, ws);
+}
+
+template<typename Real>
+WireCell::Array::array_xxz<Real> WireCell::Array::rdft(const WireCell::Array::array_xxr<Real>& arr)
+{
+    array_xxz<Real> ret;
+    rdft(arr, ret);
     return ret;
 }
 
-WireCell::Array::array_xxc WireCell::Array::idft_cc(const WireCell::Array::array_xxc& arr, int dim)
+template<typename Real>
+void WireCell::Array::rdft(const WireCell::Array::array_xxr<Real>& arr, WireCell::Array::array_xxz<Real>& spec)
 {
-    const int nrows = arr.rows();
-    const int ncols = arr.cols();
+    spec.resize(arr.rows(), arr.cols()/2+1);
+    rfwd_rows(spec, arr);
+    fwd_cols(spec, spec);
+}
 
-    // fft works on matrices, not arrays, also don't step on const input
-    Eigen::MatrixXcf ret(nrows, ncols);
-    ret = arr.matrix();
+WireCell::Array::array_xxc WireCell::Array::rdft(const WireCell::Array::array_xxf& arr)
+{
+    return rdft<float>(arr);
+}
 
-    Eigen::FFT< float > fft;
+void WireCell::Array::rdft(const WireCell::Array::array_xxf& arr, WireCell::Array::array_xxc& spec)
+{
+    rdft<float>(arr, spec);
+}
 
-    if (dim == 1) {
-        for (int icol = 0; icol < ncols; ++icol) {
-            Eigen::VectorXcf pspec(nrows);
-            fft.inv(pspec, ret.col(icol));
-            ret.col(icol) = pspec;
-        }
+// A half spectrum must have the width rdft() gives ncols columns.
+template<typename Complex>
+static void assert_half_width(const Complex& spec, int ncols)
+{
+    if (ncols < 1 || spec.cols() != ncols/2+1) {
+        THROW(ValueError() << errmsg{"half spectrum width does not match the number of columns"});
     }
-    else if (dim == 0) {
-        for (int irow = 0; irow < nrows; ++irow) {
-            Eigen::VectorXcf pspec(ncols);
-            fft.inv(pspec, ret.row(irow));
-            ret.row(irow) = pspec;
+}
+
+template<typename Real>
+WireCell::Array::array_xxr<Real> WireCell::Array::irdft(const WireCell::Array::array_xxz<Real>& arr, int ncols)
+{
+    assert_half_width(arr, ncols);
+    array_xxz<Real> partial(arr.rows(), arr.cols());
+    inv_cols(partial, arr);
+
+    array_xxr<Real> ret(arr.rows(), ncols);
+    rinv_rows(ret, partial);
+    return ret;
+}
+
+template<typename Real>
+void WireCell::Array::irdft(WireCell::Array::array_xxz<Real>& spec, int ncols, WireCell::Array::array_xxr<Real>& arr)
+{
+    assert_half_width(spec, ncols);
+    inv_cols(spec, spec);
+    arr.resize(spec.rows(), ncols);
+    rinv_rows(arr, spec);
+}
+
+WireCell::Array::array_xxf WireCell::Array::irdft(const WireCell::Array::array_xxc& arr, int ncols)
+{
+    return irdft<float>(arr, ncols);
+}
+
+void WireCell::Array::irdft(WireCell::Array::array_xxc& spec, int ncols, WireCell::Array::array_xxf& arr)
+{
+    irdft<float>(spec, ncols, arr);
+}
+
+template<typename Real>
+WireCell::Array::array_xxr<Real>
+WireCell::Array::rdeconv(const WireCell::Array::array_xxr<Real>& arr,
+                         const WireCell::Array::array_xxz<Real>& filter)
+{
+    array_xxr<Real> ret = arr;
+    BasicWorkspace<Real> ws;
+    rdeconv(ret, filter, ws);
+    return ret;
+}
+
+template<typename Real>
+void WireCell::Array::rdeconv(WireCell::Array::array_xxr<Real>& arr,
+                              const WireCell::Array::array_xxz<Real>& filter,
+                              WireCell::Array::BasicWorkspace<Real>& ws)
+{
+    assert_filter_shape(filter, arr.rows(), arr.cols()/2+1);
+
+    array_xxz<Real>& work = ws.spec;
+    work.resize(arr.rows(), arr.cols()/2+1);
+    rfwd_rows(work, arr);
+    fwd_cols(work, work);
+
+    apply_filter(work, filter);
+
+    inv_cols(work, work);
+    rinv_rows(arr, work);
+}
+
+WireCell::Array::array_xxf
+WireCell::Array::rdeconv(const WireCell::Array::array_xxf& arr,
+                         const WireCell::Array::array_xxc& filter)
+{
+    return rdeconv<float>(arr, filter);
+}
+
+void WireCell::Array::rdeconv(WireCell::Array::array_xxf& arr,
+                              const WireCell::Array::array_xxc& filter,
+                              WireCell::Array::Workspace& ws)
+{
+    rdeconv<float>(arr, filter, ws);
+}
+
+// The precisions provided.
+#define WCT_ARRAY_INSTANTIATE(Real)                                     \
+    template array_xxz<Real> WireCell::Array::dft<Real>(const array_xxr<Real>&); \
+    template void WireCell::Array::dft<Real>(const array_xxr<Real>&, array_xxz<Real>&); \
+    template array_xxr<Real> WireCell::Array::idft<Real>(const array_xxz<Real>&); \
+    template void WireCell::Array::idft<Real>(array_xxz<Real>&, array_xxr<Real>&); \
+    template array_xxz<Real> WireCell::Array::rdft<Real>(const array_xxr<Real>&); \
+    template void WireCell::Array::rdft<Real>(const array_xxr<Real>&, array_xxz<Real>&); \
+    template array_xxr<Real> WireCell::Array::irdft<Real>(const array_xxz<Real>&, int); \
+    template void WireCell::Array::irdft<Real>(array_xxz<Real>&, int, array_xxr<Real>&); \
+    template array_xxr<Real> WireCell::Array::deconv<Real>(const array_xxr<Real>&, const array_xxz<Real>&); \
+    template void WireCell::Array::deconv<Real>(array_xxr<Real>&, const array_xxz<Real>&, BasicWorkspace<Real>&); \
+    template array_xxr<Real> WireCell::Array::rdeconv<Real>(const array_xxr<Real>&, const array_xxz<Real>&); \
+    template void WireCell::Array::rdeconv<Real>(array_xxr<Real>&, const array_xxz<Real>&, BasicWorkspace<Real>&);
+
+WCT_ARRAY_INSTANTIATE(float)
+WCT_ARRAY_INSTANTIATE(double)
+
+
+WireCell::Array::Deconvolver::Deconvolver(const array_xxc& filter, int nrows, int ncols)
+    : m_nrows(nrows)
+    , m_ncols(ncols)
+{
+    const int nhalf = ncols/2+1;
+    if (filter.rows() != nrows || (filter.cols() != ncols && filter.cols() != nhalf)) {
+        THROW(ValueError() << errmsg{"deconvolver filter shape does not match its frame shape"});
+    }
+    m_filter = filter.leftCols(nhalf);
+}
+
+WireCell::Array::Deconvolver::~Deconvolver()
+{
+}
+
+WireCell::Array::Workspace* WireCell::Array::Deconvolver::acquire()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_free.empty()) {
+        m_all.emplace_back(new Workspace);
+        m_free.reserve(m_all.size());
+        return m_all.back().get();
+    }
+    Workspace* ws = m_free.back();
+    m_free.pop_back();
+    return ws;
+}
+
+void WireCell::Array::Deconvolver::release(Workspace* ws)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free.push_back(ws);
+}
+
+void WireCell::Array::Deconvolver::operator()(array_xxf& frame)
+{
+    if (frame.rows() != m_nrows || frame.cols() != m_ncols) {
+        THROW(ValueError() << errmsg{"frame shape does not match deconvolver"});
+    }
+    Workspace* ws = acquire();
+    try {
+        rdeconv(frame, m_filter, *ws);
+    }
+    catch (...) {
+        release(ws);
+        throw;
+    }
+    release(ws);
+}
+
+void WireCell::Array::Deconvolver::operator()(std::vector<array_xxf>& frames)
+{
+    Parallel::for_range(frames.size(), [&](int beg, int end) {
+        for (int ind = beg; ind < end; ++ind) {
+            (*this)(frames[ind]);
         }
+    });
+}
+
+
+WireCell::Array::StreamDeconvolver::StreamDeconvolver(const array_xxf& kernel, int pre, int nblock)
+    : m_nrows(kernel.rows())
+    , m_nkern(kernel.cols())
+    , m_pre(pre)
+    , m_nblock(nblock)
+{
+    if (m_nkern < 1 || pre < 0 || pre >= m_nkern) {
+        THROW(ValueError() << errmsg{"stream deconvolution kernel needs 0 <= pre < ncols"});
+    }
+    if (nblock < m_nkern) {
+        THROW(ValueError() << errmsg{"stream deconvolution block shorter than its kernel"});
+    }
+    array_xxf padded = array_xxf::Zero(m_nrows, nblock);
+    padded.leftCols(m_nkern) = kernel;
+    m_spec = rdft(padded);
+    m_buffer.resize(m_nrows, nblock);
+    m_block.resize(m_nrows, nblock);
+    reset();
+}
+
+WireCell::Array::array_xxf
+WireCell::Array::StreamDeconvolver::kernel(const array_xxc& filter, int pre, int post)
+{
+    const array_xxf full = idft(filter);
+    const int ncols = full.cols();
+    array_xxf ret(full.rows(), pre + 1 + post);
+    for (int ind = 0; ind < ret.cols(); ++ind) {
+        const int icol = ((ind - pre) % ncols + ncols) % ncols;
+        ret.col(ind) = full.col(icol);
     }
     return ret;
 }
 
-WireCell::Array::array_xxf WireCell::Array::idft_cr(const WireCell::Array::array_xxc& arr, int dim)
+void WireCell::Array::StreamDeconvolver::reset()
 {
-    const int nrows = arr.rows();
-    const int ncols = arr.cols();
+    // The first block starts with the history before tick 0.
+    m_nfill = m_nkern - 1 - m_pre;
+    m_buffer.leftCols(m_nfill).setZero();
+    m_nin = m_nout = 0;
+}
 
-    // fft works on matrices, not arrays, also don't step on const input
-    Eigen::MatrixXcf partial(nrows, ncols);
-    partial = arr.matrix();
+// Deconvolve the full buffer, append the valid columns to out and
+// keep the last K-1 input columns as history of the next block.
+void WireCell::Array::StreamDeconvolver::process(array_xxf& out)
+{
+    const int nhist = m_nkern - 1;
+    const int nvalid = m_nblock - nhist;
 
-    Eigen::FFT< float > fft;
+    m_block = m_buffer;
+    rdeconv(m_block, m_spec, m_ws);
 
-    array_xxf ret(nrows, ncols);
+    const int nwant = std::min<long>(nvalid, m_nin - m_nout);
+    const int ncols = out.cols();
+    out.conservativeResize(m_nrows, ncols + nwant);
+    out.rightCols(nwant) = m_block.middleCols(nhist, nwant);
+    m_nout += nwant;
 
-    if (dim == 0) {
-        for (int irow = 0; irow < nrows; ++irow) {
-            Eigen::VectorXf wave(ncols); // back to real-valued time series
-            fft.inv(wave, partial.row(irow));
-            ret.row(irow) = wave;
-        }
+    for (int icol = 0; icol < nhist; ++icol) {
+        m_buffer.col(icol) = m_buffer.col(icol + nvalid);
     }
-    else if (dim == 1) {
-        for (int icol = 0; icol < ncols; ++icol) {
-            Eigen::VectorXf wave(nrows);
-            fft.inv(wave, partial.col(icol));
-            ret.col(icol) = wave;
+    m_nfill = nhist;
+}
+
+WireCell::Array::array_xxf
+WireCell::Array::StreamDeconvolver::operator()(const array_xxf& chunk)
+{
+    if (chunk.rows() != m_nrows) {
+        THROW(ValueError() << errmsg{"chunk row count does not match stream deconvolution kernel"});
+    }
+    array_xxf out(m_nrows, 0);
+    const int nchunk = chunk.cols();
+    int icol = 0;
+    while (icol < nchunk) {
+        const int ncopy = std::min(m_nblock - m_nfill, nchunk - icol);
+        m_buffer.middleCols(m_nfill, ncopy) = chunk.middleCols(icol, ncopy);
+        m_nfill += ncopy;
+        m_nin += ncopy;
+        icol += ncopy;
+        if (m_nfill == m_nblock) {
+            process(out);
         }
     }
+    return out;
+}
+
+WireCell::Array::array_xxf WireCell::Array::StreamDeconvolver::flush()
+{
+    array_xxf out(m_nrows, 0);
+    // Zeros after the end until every fed tick is emitted.
+    while (m_nout < m_nin) {
+        m_buffer.rightCols(m_nblock - m_nfill).setZero();
+        m_nfill = m_nblock;
+        process(out);
+    }
+    reset();
+    return out;
+}
+
+
+int WireCell::Array::padded_cols(int ncols)
+{
+    return fft_best_length(ncols);
+}
+
+WireCell::Array::array_xxf
+WireCell::Array::pad(const WireCell::Array::array_xxf& arr, int ncols, Waveform::PadType type)
+{
+    const int norig = arr.cols();
+    if (ncols <= norig) {
+        return arr;
+    }
+    array_xxf ret = array_xxf::Zero(arr.rows(), ncols);
+    ret.leftCols(norig) = arr;
+    if (type == Waveform::pad_zero || norig == 0) {
+        return ret;
+    }
+    // same reflection as Waveform::pad()
+    const int period = std::max(1, 2*(norig-1));
+    for (int icol = norig; icol < ncols; ++icol) {
+        const int phase = icol % period;
+        ret.col(icol) = arr.col(phase < norig ? phase : period - phase);
+    }
     return ret;
 }
 
+WireCell::Array::array_xxc
+WireCell::Array::dft_padded(const WireCell::Array::array_xxf& arr, int& npad, Waveform::PadType type)
+{
+    npad = padded_cols(arr.cols()) - arr.cols();
+    if (npad == 0) {
+        return dft(arr);
+    }
+    return dft(pad(arr, arr.cols() + npad, type));
+}
 
+WireCell::Array::array_xxf
+WireCell::Array::idft_cropped(const WireCell::Array::array_xxc& spec, int npad)
+{
+    if (npad < 0 || npad > spec.cols()) {
+        THROW(ValueError() << errmsg{"idft_cropped: npad out of range"});
+    }
+    array_xxf full = idft(spec);
+    return full.leftCols(full.cols() - npad);
+}
 
-// this is a cut-and-paste mashup of dft() and idft() in order to avoid temporaries.
 WireCell::Array::array_xxf
-WireCell::Array::deconv(const WireCell::Array::array_xxf& arr,
-			const WireCell::Array::array_xxc& filter)
+WireCell::Array::deconv_padded(const WireCell::Array::array_xxf& arr,
+                               const WireCell::Array::array_xxc& filter,
+                               Waveform::PadType type)
 {
-    const int nrows = arr.rows();
-    const int ncols = arr.cols();
+    const int ncols = padded_cols(arr.cols());
+    array_xxf work = pad(arr, ncols, type);
+    Workspace ws;
+    deconv(work, filter, ws);
+    return work.leftCols(arr.cols());
+}
 
-    Eigen::FFT< float > fft;
 
-    Eigen::MatrixXcf matc(nrows, ncols);
-    for (int irow = 0; irow < nrows; ++irow) {
-	Eigen::VectorXcf fspec(ncols); // frequency spectrum 
-	// fft wants vectors, also input arr is const
-	Eigen::VectorXf tmp = arr.row(irow);
-	fft.fwd(fspec, tmp);
-	matc.row(irow) = fspec;
+// Mean and RMS of nr <= 16 rows from row0 by a sweep over columns.
+// Sums are of differences from the first column, as in
+// Waveform::mean_rms(), and are kept in double.  A full cache line of
+// rows has a fixed trip count so the sums stay in registers.
+template<int nfixed>
+static void block_mean_rms(const array_xxf& arr, int row0, int nr, array_xd& mean, array_xd& rms)
+{
+    const int n = nfixed ? nfixed : nr;
+    const int ncols = arr.cols();
+    double shift[16], s1[16] = {0}, s2[16] = {0};
+    for (int ind = 0; ind < n; ++ind) {
+        shift[ind] = arr(row0 + ind, 0);
     }
-    
-    for (int icol = 0; icol < ncols; ++icol) {
-	Eigen::VectorXcf pspec(nrows); // periodicity spectrum
-	fft.fwd(pspec, matc.col(icol));
-	matc.col(icol) = pspec;
+    for (int icol = 1; icol < ncols; ++icol) {
+        const float* col = &arr(row0, icol);
+        for (int ind = 0; ind < n; ++ind) {
+            const double d = col[ind] - shift[ind];
+            s1[ind] += d;
+            s2[ind] += d*d;
+        }
+    }
+    for (int ind = 0; ind < n; ++ind) {
+        mean[row0+ind] = shift[ind] + s1[ind]/ncols;
+        rms[row0+ind] = std::sqrt(std::max(0.0, (s2[ind] - s1[ind]*s1[ind]/ncols) / ncols));
     }
+}
 
-    // deconvolution via multiplication in frequency space
-    Eigen::MatrixXcf filt = matc.array() * filter;
+void WireCell::Array::mean_rms(const WireCell::Array::array_xxf& arr,
+                               WireCell::Array::array_xd& mean,
+                               WireCell::Array::array_xd& rms)
+{
+    const int nrows = arr.rows(), ncols = arr.cols();
+    mean = array_xd::Zero(nrows);
+    rms = array_xd::Zero(nrows);
+    if (ncols == 0) {
+        return;
+    }
+    const int nblock = 16;
+    const int nblocks = (nrows + nblock - 1) / nblock;
+    Parallel::for_range(nblocks, [&](int beg, int end) {
+        for (int iblock = beg; iblock < end; ++iblock) {
+            const int row0 = iblock*nblock;
+            const int nr = std::min(nblock, nrows - row0);
+            if (nr == nblock) {
+                block_mean_rms<nblock>(arr, row0, nr, mean, rms);
+            }
+            else {
+                block_mean_rms<0>(arr, row0, nr, mean, rms);
+            }
+        }
+    });
+}
 
+std::vector<short> WireCell::Array::most_frequent(const WireCell::Array::array_xxs& adc)
+{
+    std::vector<short> ret(adc.rows());
+    Parallel::for_range(adc.rows(), [&](int beg, int end) {
+        for (int irow = beg; irow < end; ++irow) {
+            ret[irow] = Waveform::most_frequent(adc.row(irow));
+        }
+    });
+    return ret;
+}
+
+std::vector<int> WireCell::Array::active_rows(const WireCell::Array::array_xxf& arr)
+{
+    // Scan along the contiguous columns, marking rows as we go.
+    const int nrows = arr.rows();
+    const int ncols = arr.cols();
+    std::vector<char> active(nrows, 0);
     for (int icol = 0; icol < ncols; ++icol) {
-        Eigen::VectorXcf pspec(nrows); // wire spectrum
-        fft.inv(pspec, filt.col(icol));
-        filt.col(icol) = pspec;
+        const float* col = &arr(0, icol);
+        for (int irow = 0; irow < nrows; ++irow) {
+            active[irow] |= (col[irow] != 0.0f);
+        }
     }
+    std::vector<int> ret;
+    for (int irow = 0; irow < nrows; ++irow) {
+        if (active[irow]) {
+            ret.push_back(irow);
+        }
+    }
+    return ret;
+}
 
-    array_xxf ret(nrows, ncols);
+// The row pass groups runs of consecutive rows so the list must be
+// sorted and free of duplicates.
+static void assert_rows(const std::vector<int>& rows, int nrows)
+{
+    for (size_t ind = 0; ind < rows.size(); ++ind) {
+        const int irow = rows[ind];
+        if (irow < 0 || irow >= nrows) {
+            THROW(IndexError() << errmsg{"active row index out of range"});
+        }
+        if (ind && irow <= rows[ind-1]) {
+            THROW(ValueError() << errmsg{"active rows must be strictly increasing"});
+        }
+    }
+}
 
-    for (int irow = 0; irow < nrows; ++irow) {
-        Eigen::VectorXf wave(ncols); // back to real-valued time series
-        fft.inv(wave, filt.row(irow));
-        ret.row(irow) = wave;
+WireCell::Array::array_xxc WireCell::Array::dft_sparse(const WireCell::Array::array_xxf& arr)
+{
+    array_xxc spec;
+    dft(arr, spec, active_rows(arr));
+    return spec;
+}
+
+void WireCell::Array::dft(const WireCell::Array::array_xxf& arr, WireCell::Array::array_xxc& spec,
+                          const std::vector<int>& rows)
+{
+    assert_rows(rows, arr.rows());
+    spec.resize(arr.rows(), arr.cols());
+    fwd_rows(spec, arr, rows);
+    fwd_cols(spec, spec);
+}
+
+void WireCell::Array::rdft(const WireCell::Array::array_xxf& arr, WireCell::Array::array_xxc& spec,
+                           const std::vector<int>& rows)
+{
+    assert_rows(rows, arr.rows());
+    spec.resize(arr.rows(), arr.cols()/2+1);
+    rfwd_rows(spec, arr, rows);
+    fwd_cols(spec, spec);
+}
+
+void WireCell::Array::deconv(WireCell::Array::array_xxf& arr,
+                             const WireCell::Array::array_xxc& filter,
+                             WireCell::Array::Workspace& ws,
+                             const std::vector<int>& rows)
+{
+    assert_filter_shape(filter, arr.rows(), arr.cols());
+    dft(arr, ws.spec, rows);
+    apply_filter(ws.spec, filter);
+    inv_cols(ws.spec, ws.spec);
+    inv_rows(arr, ws.spec);
+}
+
+void WireCell::Array::rdeconv(WireCell::Array::array_xxf& arr,
+                              const WireCell::Array::array_xxc& filter,
+                              WireCell::Array::Workspace& ws,
+                              const std::vector<int>& rows)
+{
+    assert_filter_shape(filter, arr.rows(), arr.cols()/2+1);
+    rdft(arr, ws.spec, rows);
+    apply_filter(ws.spec, filter);
+    inv_cols(ws.spec, ws.spec);
+    rinv_rows(arr, ws.spec);
+}
+
+
+// Pedestals default to zero.
+static const float* pedestal_data(const std::vector<float>& pedestals, int nrows)
+{
+    static thread_local std::vector<float> zeros;
+    if (pedestals.empty()) {
+        zeros.resize(nrows, 0.0f);
+        return zeros.data();
     }
+    if ((int)pedestals.size() != nrows) {
+        THROW(ValueError() << errmsg{"need one pedestal per ADC array row"});
+    }
+    return pedestals.data();
+}
 
-    return ret;
+WireCell::Array::array_xxc WireCell::Array::dft(const WireCell::Array::array_xxs& adc,
+                                                const std::vector<float>& pedestals)
+{
+    array_xxc spec;
+    dft(adc, pedestals, spec);
+    return spec;
 }
 
+void WireCell::Array::dft(const WireCell::Array::array_xxs& adc,
+                          const std::vector<float>& pedestals,
+                          WireCell::Array::array_xxc& spec)
+{
+    const float* ped = pedestal_data(pedestals, adc.rows());
+    spec.resize(adc.rows(), adc.cols());
+    adc_rows(spec, adc, ped, op_fwd);
+    fwd_cols(spec, spec);
+}
+
+void WireCell::Array::rdft(const WireCell::Array::array_xxs& adc,
+                           const std::vector<float>& pedestals,
+                           WireCell::Array::array_xxc& spec)
+{
+    const float* ped = pedestal_data(pedestals, adc.rows());
+    spec.resize(adc.rows(), adc.cols()/2+1);
+    adc_rows(spec, adc, ped, op_rfwd);
+    fwd_cols(spec, spec);
+}
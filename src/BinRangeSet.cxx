@@ -0,0 +1,314 @@
+#include "WireCellUtil/BinRangeSet.h"
+#include "WireCellUtil/Exceptions.h"
+
+#include <algorithm>
+
+using namespace WireCell;
+using namespace WireCell::Waveform;
+
+// Sweep the edges of two sets in order, emitting an edge wherever
+// op(in a, in b) changes.  Being inside a set after passing an edge
+// is the parity of the number of its edges passed.  All edges at one
+// position are passed before op is evaluated so touching ranges join.
+template<typename Op>
+static void sweep(const int* a, size_t na, const int* b, size_t nb,
+                  std::vector<int>& out, Op op)
+{
+    size_t ia = 0, ib = 0;
+    bool inside = false;
+    while (ia < na || ib < nb) {
+        int pos;
+        if (ib == nb || (ia < na && a[ia] <= b[ib])) {
+            pos = a[ia];
+        }
+        else {
+            pos = b[ib];
+        }
+        if (ia < na && a[ia] == pos) { ++ia; }
+        if (ib < nb && b[ib] == pos) { ++ib; }
+        const bool now = op(bool(ia & 1), bool(ib & 1));
+        if (now != inside) {
+            out.push_back(pos);
+            inside = now;
+        }
+    }
+}
+
+namespace {
+    struct Union { bool operator()(bool a, bool b) const { return a || b; } };
+    struct Intersection { bool operator()(bool a, bool b) const { return a && b; } };
+    struct Difference { bool operator()(bool a, bool b) const { return a && !b; } };
+}
+
+
+WireCell::Waveform::BinRangeSet::BinRangeSet(const BinRangeList& brl)
+{
+    BinRangeList tmp;
+    tmp.reserve(brl.size());
+    for (const auto& br : brl) {
+        if (br.first < br.second) {
+            tmp.push_back(br);
+        }
+    }
+    std::sort(tmp.begin(), tmp.end());
+    m_edges.reserve(2*tmp.size());
+    for (const auto& br : tmp) {
+        if (!m_edges.empty() && m_edges.back() >= br.first) {
+            m_edges.back() = std::max(m_edges.back(), br.second);
+            continue;
+        }
+        m_edges.push_back(br.first);
+        m_edges.push_back(br.second);
+    }
+}
+
+BinRangeSet WireCell::Waveform::BinRangeSet::from_edges(std::vector<int> edges)
+{
+    if (edges.size() % 2) {
+        THROW(ValueError() << errmsg{"BinRangeSet: odd number of edges"});
+    }
+    for (size_t ind = 1; ind < edges.size(); ++ind) {
+        if (edges[ind-1] >= edges[ind]) {
+            THROW(ValueError() << errmsg{"BinRangeSet: edges not strictly increasing"});
+        }
+    }
+    BinRangeSet ret;
+    ret.m_edges = std::move(edges);
+    return ret;
+}
+
+BinRangeList WireCell::Waveform::BinRangeSet::ranges() const
+{
+    BinRangeList ret(size());
+    for (size_t ind = 0; ind < ret.size(); ++ind) {
+        ret[ind] = BinRange(m_edges[2*ind], m_edges[2*ind+1]);
+    }
+    return ret;
+}
+
+int WireCell::Waveform::BinRangeSet::nbins() const
+{
+    int ret = 0;
+    for (size_t ind = 0; ind < m_edges.size(); ind += 2) {
+        ret += m_edges[ind+1] - m_edges[ind];
+    }
+    return ret;
+}
+
+bool WireCell::Waveform::BinRangeSet::contains(int bin) const
+{
+    // inside if an odd number of edges are at or below bin
+    auto it = std::upper_bound(m_edges.begin(), m_edges.end(), bin);
+    return (it - m_edges.begin()) & 1;
+}
+
+void WireCell::Waveform::BinRangeSet::insert(int beg, int end)
+{
+    if (beg >= end) {
+        return;
+    }
+    const int one[2] = {beg, end};
+    std::vector<int> out;
+    out.reserve(m_edges.size() + 2);
+    sweep(m_edges.data(), m_edges.size(), one, 2, out, Union());
+    m_edges.swap(out);
+}
+
+BinRangeSet& WireCell::Waveform::BinRangeSet::operator|=(const BinRangeSet& other)
+{
+    std::vector<int> out;
+    out.reserve(m_edges.size() + other.m_edges.size());
+    sweep(m_edges.data(), m_edges.size(), other.m_edges.data(), other.m_edges.size(), out, Union());
+    m_edges.swap(out);
+    return *this;
+}
+
+BinRangeSet& WireCell::Waveform::BinRangeSet::operator&=(const BinRangeSet& other)
+{
+    std::vector<int> out;
+    out.reserve(std::min(m_edges.size(), other.m_edges.size())*2);
+    sweep(m_edges.data(), m_edges.size(), other.m_edges.data(), other.m_edges.size(), out, Intersection());
+    m_edges.swap(out);
+    return *this;
+}
+
+BinRangeSet& WireCell::Waveform::BinRangeSet::operator-=(const BinRangeSet& other)
+{
+    std::vector<int> out;
+    out.reserve(m_edges.size() + other.m_edges.size());
+    sweep(m_edges.data(), m_edges.size(), other.m_edges.data(), other.m_edges.size(), out, Difference());
+    m_edges.swap(out);
+    return *this;
+}
+
+BinRangeSet WireCell::Waveform::operator|(const BinRangeSet& a, const BinRangeSet& b)
+{
+    BinRangeSet ret(a);
+    ret |= b;
+    return ret;
+}
+BinRangeSet WireCell::Waveform::operator&(const BinRangeSet& a, const BinRangeSet& b)
+{
+    BinRangeSet ret(a);
+    ret &= b;
+    return ret;
+}
+BinRangeSet WireCell::Waveform::operator-(const BinRangeSet& a, const BinRangeSet& b)
+{
+    BinRangeSet ret(a);
+    ret -= b;
+    return ret;
+}
+
+
+WireCell::Waveform::ChannelMaskSet::ChannelMaskSet(const ChannelMasks& cm)
+    : m_offsets(1, 0)
+{
+    m_channels.reserve(cm.size());
+    m_offsets.reserve(cm.size() + 1);
+    for (const auto& it : cm) {
+        BinRangeSet brs(it.second);
+        if (brs.empty()) {
+            continue;
+        }
+        const auto& edges = brs.edges();
+        m_channels.push_back(it.first);
+        m_edges.insert(m_edges.end(), edges.begin(), edges.end());
+        m_offsets.push_back(m_edges.size());
+    }
+}
+
+ChannelMasks WireCell::Waveform::ChannelMaskSet::masks() const
+{
+    ChannelMasks ret;
+    for (size_t ind = 0; ind < m_channels.size(); ++ind) {
+        // channels are sorted so each insert is at the end
+        ret.emplace_hint(ret.end(), m_channels[ind], at(ind).ranges());
+    }
+    return ret;
+}
+
+int WireCell::Waveform::ChannelMaskSet::index(int channel) const
+{
+    auto it = std::lower_bound(m_channels.begin(), m_channels.end(), channel);
+    if (it == m_channels.end() || *it != channel) {
+        return -1;
+    }
+    return it - m_channels.begin();
+}
+
+BinRangeSet WireCell::Waveform::ChannelMaskSet::at(size_t index) const
+{
+    if (index >= m_channels.size()) {
+        THROW(ValueError() << errmsg{"ChannelMaskSet: index out of range"});
+    }
+    return BinRangeSet::from_edges(std::vector<int>(m_edges.begin() + m_offsets[index],
+                                                    m_edges.begin() + m_offsets[index+1]));
+}
+
+BinRangeSet WireCell::Waveform::ChannelMaskSet::ranges(int channel) const
+{
+    const int ind = index(channel);
+    if (ind < 0) {
+        return BinRangeSet();
+    }
+    return at(ind);
+}
+
+bool WireCell::Waveform::ChannelMaskSet::contains(int channel, int bin) const
+{
+    const int ind = index(channel);
+    if (ind < 0) {
+        return false;
+    }
+    auto beg = m_edges.begin() + m_offsets[ind];
+    auto end = m_edges.begin() + m_offsets[ind+1];
+    return (std::upper_bound(beg, end, bin) - beg) & 1;
+}
+
+bool WireCell::Waveform::ChannelMaskSet::operator==(const ChannelMaskSet& other) const
+{
+    return m_channels == other.m_channels
+        && m_offsets == other.m_offsets
+        && m_edges == other.m_edges;
+}
+
+// Walk the two channel lists in order and sweep the ranges of each
+// channel in either.  A channel missing from one set has no ranges.
+template<typename Op>
+ChannelMaskSet WireCell::Waveform::ChannelMaskSet::combine(const ChannelMaskSet& a,
+                                                           const ChannelMaskSet& b, Op op)
+{
+    ChannelMaskSet ret;
+    ret.m_channels.reserve(a.m_channels.size() + b.m_channels.size());
+    ret.m_offsets.reserve(a.m_channels.size() + b.m_channels.size() + 1);
+    ret.m_edges.reserve(a.m_edges.size() + b.m_edges.size());
+
+    const size_t na = a.m_channels.size(), nb = b.m_channels.size();
+    size_t ia = 0, ib = 0;
+    while (ia < na || ib < nb) {
+        int ch;
+        if (ib == nb || (ia < na && a.m_channels[ia] <= b.m_channels[ib])) {
+            ch = a.m_channels[ia];
+        }
+        else {
+            ch = b.m_channels[ib];
+        }
+        const int* ea = nullptr; size_t nea = 0;
+        const int* eb = nullptr; size_t neb = 0;
+        if (ia < na && a.m_channels[ia] == ch) {
+            ea = a.m_edges.data() + a.m_offsets[ia];
+            nea = a.m_offsets[ia+1] - a.m_offsets[ia];
+            ++ia;
+        }
+        if (ib < nb && b.m_channels[ib] == ch) {
+            eb = b.m_edges.data() + b.m_offsets[ib];
+            neb = b.m_offsets[ib+1] - b.m_offsets[ib];
+            ++ib;
+        }
+        const size_t before = ret.m_edges.size();
+        sweep(ea, nea, eb, neb, ret.m_edges, op);
+        if (ret.m_edges.size() > before) {
+            ret.m_channels.push_back(ch);
+            ret.m_offsets.push_back(ret.m_edges.size());
+        }
+    }
+    return ret;
+}
+
+ChannelMaskSet& WireCell::Waveform::ChannelMaskSet::operator|=(const ChannelMaskSet& other)
+{
+    *this = combine(*this, other, Union());
+    return *this;
+}
+
+ChannelMaskSet& WireCell::Waveform::ChannelMaskSet::operator&=(const ChannelMaskSet& other)
+{
+    *this = combine(*this, other, Intersection());
+    return *this;
+}
+
+ChannelMaskSet& WireCell::Waveform::ChannelMaskSet::operator-=(const ChannelMaskSet& other)
+{
+    *this = combine(*this, other, Difference());
+    return *this;
+}
+
+ChannelMaskSet WireCell::Waveform::operator|(const ChannelMaskSet& a, const ChannelMaskSet& b)
+{
+    ChannelMaskSet ret(a);
+    ret |= b;
+    return ret;
+}
+ChannelMaskSet WireCell::Waveform::operator&(const ChannelMaskSet& a, const ChannelMaskSet& b)
+{
+    ChannelMaskSet ret(a);
+    ret &= b;
+    return ret;
+}
+ChannelMaskSet WireCell::Waveform::operator-(const ChannelMaskSet& a, const ChannelMaskSet& b)
+{
+    ChannelMaskSet ret(a);
+    ret -= b;
+    return ret;
+}
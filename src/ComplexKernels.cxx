@@ -0,0 +1,366 @@
+#include "WireCellUtil/ComplexKernels.h"
+
+#include <atomic>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define WCT_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+using namespace WireCell;
+using namespace WireCell::ComplexKernels;
+
+// Scalar versions spell out the arithmetic rather than relying on
+// std::complex operators which, without -ffast-math, take a slow
+// path for the sake of infinities.  Inputs are read before output is
+// written so that aliasing is safe.
+
+template<typename T>
+static void mul_scalar(std::complex<T>* out, const std::complex<T>* a,
+                       const std::complex<T>* b, size_t n)
+{
+    for (size_t ind = 0; ind < n; ++ind) {
+        const T ar = a[ind].real(), ai = a[ind].imag();
+        const T br = b[ind].real(), bi = b[ind].imag();
+        out[ind] = std::complex<T>(ar*br - ai*bi, ar*bi + ai*br);
+    }
+}
+
+template<typename T>
+static void mulc_scalar(std::complex<T>* out, const std::complex<T>* a,
+                        const std::complex<T>* b, size_t n)
+{
+    for (size_t ind = 0; ind < n; ++ind) {
+        const T ar = a[ind].real(), ai = a[ind].imag();
+        const T br = b[ind].real(), bi = b[ind].imag();
+        out[ind] = std::complex<T>(ar*br + ai*bi, ai*br - ar*bi);
+    }
+}
+
+template<typename T>
+static void div_scalar(std::complex<T>* out, const std::complex<T>* a,
+                       const std::complex<T>* b, size_t n, T eps)
+{
+    for (size_t ind = 0; ind < n; ++ind) {
+        const T ar = a[ind].real(), ai = a[ind].imag();
+        const T br = b[ind].real(), bi = b[ind].imag();
+        const T norm = br*br + bi*bi;
+        if (!(norm > eps)) {
+            out[ind] = 0;
+            continue;
+        }
+        out[ind] = std::complex<T>((ar*br + ai*bi)/norm, (ai*br - ar*bi)/norm);
+    }
+}
+
+typedef std::complex<float> cfloat;
+typedef void (*mul_func)(cfloat*, const cfloat*, const cfloat*, size_t);
+typedef void (*div_func)(cfloat*, const cfloat*, const cfloat*, size_t, float);
+
+#ifdef WCT_X86_KERNELS
+
+// Interleaved (re, im) pairs.  With a = (ar, ai) and b = (br, bi):
+//   bre = (br, br), bim = (bi, bi), aswap = (ai, ar)
+//   a*b       = a*bre -/+ aswap*bim   (subtract in re, add in im)
+//   a*conj(b) = a*bre +/- aswap*bim
+//   |b|^2     = b*b + swap(b*b)
+
+// ---- SSE4.1, 2 complex per vector
+
+__attribute__((target("sse4.1")))
+static void mul_sse4(cfloat* out, const cfloat* a, const cfloat* b, size_t n)
+{
+    const float* pa = reinterpret_cast<const float*>(a);
+    const float* pb = reinterpret_cast<const float*>(b);
+    float* po = reinterpret_cast<float*>(out);
+    size_t ind = 0;
+    for (; ind + 2 <= n; ind += 2) {
+        const __m128 va = _mm_loadu_ps(pa + 2*ind);
+        const __m128 vb = _mm_loadu_ps(pb + 2*ind);
+        const __m128 bre = _mm_moveldup_ps(vb);
+        const __m128 bim = _mm_movehdup_ps(vb);
+        const __m128 aswap = _mm_shuffle_ps(va, va, 0xB1);
+        _mm_storeu_ps(po + 2*ind, _mm_addsub_ps(_mm_mul_ps(va, bre), _mm_mul_ps(aswap, bim)));
+    }
+    mul_scalar(out+ind, a+ind, b+ind, n-ind);
+}
+
+__attribute__((target("sse4.1")))
+static void mulc_sse4(cfloat* out, const cfloat* a, const cfloat* b, size_t n)
+{
+    const float* pa = reinterpret_cast<const float*>(a);
+    const float* pb = reinterpret_cast<const float*>(b);
+    float* po = reinterpret_cast<float*>(out);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    size_t ind = 0;
+    for (; ind + 2 <= n; ind += 2) {
+        const __m128 va = _mm_loadu_ps(pa + 2*ind);
+        const __m128 vb = _mm_loadu_ps(pb + 2*ind);
+        const __m128 bre = _mm_moveldup_ps(vb);
+        const __m128 bim = _mm_movehdup_ps(vb);
+        const __m128 aswap = _mm_shuffle_ps(va, va, 0xB1);
+        const __m128 cross = _mm_xor_ps(_mm_mul_ps(aswap, bim), sign);
+        _mm_storeu_ps(po + 2*ind, _mm_addsub_ps(_mm_mul_ps(va, bre), cross));
+    }
+    mulc_scalar(out+ind, a+ind, b+ind, n-ind);
+}
+
+__attribute__((target("sse4.1")))
+static void div_sse4(cfloat* out, const cfloat* a, const cfloat* b, size_t n, float eps)
+{
+    const float* pa = reinterpret_cast<const float*>(a);
+    const float* pb = reinterpret_cast<const float*>(b);
+    float* po = reinterpret_cast<float*>(out);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 veps = _mm_set1_ps(eps);
+    size_t ind = 0;
+    for (; ind + 2 <= n; ind += 2) {
+        const __m128 va = _mm_loadu_ps(pa + 2*ind);
+        const __m128 vb = _mm_loadu_ps(pb + 2*ind);
+        const __m128 bre = _mm_moveldup_ps(vb);
+        const __m128 bim = _mm_movehdup_ps(vb);
+        const __m128 aswap = _mm_shuffle_ps(va, va, 0xB1);
+        const __m128 cross = _mm_xor_ps(_mm_mul_ps(aswap, bim), sign);
+        const __m128 num = _mm_addsub_ps(_mm_mul_ps(va, bre), cross);
+        const __m128 sq = _mm_mul_ps(vb, vb);
+        const __m128 norm = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, 0xB1));
+        const __m128 keep = _mm_cmpgt_ps(norm, veps);
+        _mm_storeu_ps(po + 2*ind, _mm_and_ps(keep, _mm_div_ps(num, norm)));
+    }
+    div_scalar(out+ind, a+ind, b+ind, n-ind, eps);
+}
+
+// ---- AVX2 with FMA, 4 complex per vector
+
+__attribute__((target("avx2,fma")))
+static void mul_avx2(cfloat* out, const cfloat* a, const cfloat* b, size_t n)
+{
+    const float* pa = reinterpret_cast<const float*>(a);
+    const float* pb = reinterpret_cast<const float*>(b);
+    float* po = reinterpret_cast<float*>(out);
+    size_t ind = 0;
+    for (; ind + 4 <= n; ind += 4) {
+        const __m256 va = _mm256_loadu_ps(pa + 2*ind);
+        const __m256 vb = _mm256_loadu_ps(pb + 2*ind);
+        const __m256 bre = _mm256_moveldup_ps(vb);
+        const __m256 bim = _mm256_movehdup_ps(vb);
+        const __m256 aswap = _mm256_permute_ps(va, 0xB1);
+        _mm256_storeu_ps(po + 2*ind, _mm256_fmaddsub_ps(va, bre, _mm256_mul_ps(aswap, bim)));
+    }
+    mul_sse4(out+ind, a+ind, b+ind, n-ind);
+}
+
+__attribute__((target("avx2,fma")))
+static void mulc_avx2(cfloat* out, const cfloat* a, const cfloat* b, size_t n)
+{
+    const float* pa = reinterpret_cast<const float*>(a);
+    const float* pb = reinterpret_cast<const float*>(b);
+    float* po = reinterpret_cast<float*>(out);
+    size_t ind = 0;
+    for (; ind + 4 <= n; ind += 4) {
+        const __m256 va = _mm256_loadu_ps(pa + 2*ind);
+        const __m256 vb = _mm256_loadu_ps(pb + 2*ind);
+        const __m256 bre = _mm256_moveldup_ps(vb);
+        const __m256 bim = _mm256_movehdup_ps(vb);
+        const __m256 aswap = _mm256_permute_ps(va, 0xB1);
+        _mm256_storeu_ps(po + 2*ind, _mm256_fmsubadd_ps(va, bre, _mm256_mul_ps(aswap, bim)));
+    }
+    mulc_sse4(out+ind, a+ind, b+ind, n-ind);
+}
+
+__attribute__((target("avx2,fma")))
+static void div_avx2(cfloat* out, const cfloat* a, const cfloat* b, size_t n, float eps)
+{
+    const float* pa = reinterpret_cast<const float*>(a);
+    const float* pb = reinterpret_cast<const float*>(b);
+    float* po = reinterpret_cast<float*>(out);
+    const __m256 veps = _mm256_set1_ps(eps);
+    size_t ind = 0;
+    for (; ind + 4 <= n; ind += 4) {
+        const __m256 va = _mm256_loadu_ps(pa + 2*ind);
+        const __m256 vb = _mm256_loadu_ps(pb + 2*ind);
+        const __m256 bre = _mm256_moveldup_ps(vb);
+        const __m256 bim = _mm256_movehdup_ps(vb);
+        const __m256 aswap = _mm256_permute_ps(va, 0xB1);
+        const __m256 num = _mm256_fmsubadd_ps(va, bre, _mm256_mul_ps(aswap, bim));
+        const __m256 sq = _mm256_mul_ps(vb, vb);
+        const __m256 norm = _mm256_add_ps(sq, _mm256_permute_ps(sq, 0xB1));
+        const __m256 keep = _mm256_cmp_ps(norm, veps, _CMP_GT_OQ);
+        _mm256_storeu_ps(po + 2*ind, _mm256_and_ps(keep, _mm256_div_ps(num, norm)));
+    }
+    div_sse4(out+ind, a+ind, b+ind, n-ind, eps);
+}
+
+// ---- AVX-512F, 8 complex per vector
+
+// Some GCC 12 AVX-512 intrinsics warn spuriously about their own
+// deliberately undefined vectors (GCC bug 105593).
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f")))
+static void mul_avx512(cfloat* out, const cfloat* a, const cfloat* b, size_t n)
+{
+    const float* pa = reinterpret_cast<const float*>(a);
+    const float* pb = reinterpret_cast<const float*>(b);
+    float* po = reinterpret_cast<float*>(out);
+    size_t ind = 0;
+    for (; ind + 8 <= n; ind += 8) {
+        const __m512 va = _mm512_loadu_ps(pa + 2*ind);
+        const __m512 vb = _mm512_loadu_ps(pb + 2*ind);
+        const __m512 bre = _mm512_moveldup_ps(vb);
+        const __m512 bim = _mm512_movehdup_ps(vb);
+        const __m512 aswap = _mm512_permute_ps(va, 0xB1);
+        _mm512_storeu_ps(po + 2*ind, _mm512_fmaddsub_ps(va, bre, _mm512_mul_ps(aswap, bim)));
+    }
+    mul_avx2(out+ind, a+ind, b+ind, n-ind);
+}
+
+__attribute__((target("avx512f")))
+static void mulc_avx512(cfloat* out, const cfloat* a, const cfloat* b, size_t n)
+{
+    const float* pa = reinterpret_cast<const float*>(a);
+    const float* pb = reinterpret_cast<const float*>(b);
+    float* po = reinterpret_cast<float*>(out);
+    size_t ind = 0;
+    for (; ind + 8 <= n; ind += 8) {
+        const __m512 va = _mm512_loadu_ps(pa + 2*ind);
+        const __m512 vb = _mm512_loadu_ps(pb + 2*ind);
+        const __m512 bre = _mm512_moveldup_ps(vb);
+        const __m512 bim = _mm512_movehdup_ps(vb);
+        const __m512 aswap = _mm512_permute_ps(va, 0xB1);
+        _mm512_storeu_ps(po + 2*ind, _mm512_fmsubadd_ps(va, bre, _mm512_mul_ps(aswap, bim)));
+    }
+    mulc_avx2(out+ind, a+ind, b+ind, n-ind);
+}
+
+__attribute__((target("avx512f")))
+static void div_avx512(cfloat* out, const cfloat* a, const cfloat* b, size_t n, float eps)
+{
+    const float* pa = reinterpret_cast<const float*>(a);
+    const float* pb = reinterpret_cast<const float*>(b);
+    float* po = reinterpret_cast<float*>(out);
+    const __m512 veps = _mm512_set1_ps(eps);
+    size_t ind = 0;
+    for (; ind + 8 <= n; ind += 8) {
+        const __m512 va = _mm512_loadu_ps(pa + 2*ind);
+        const __m512 vb = _mm512_loadu_ps(pb + 2*ind);
+        const __m512 bre = _mm512_moveldup_ps(vb);
+        const __m512 bim = _mm512_movehdup_ps(vb);
+        const __m512 aswap = _mm512_permute_ps(va, 0xB1);
+        const __m512 num = _mm512_fmsubadd_ps(va, bre, _mm512_mul_ps(aswap, bim));
+        const __m512 sq = _mm512_mul_ps(vb, vb);
+        const __m512 norm = _mm512_add_ps(sq, _mm512_permute_ps(sq, 0xB1));
+        const __mmask16 keep = _mm512_cmp_ps_mask(norm, veps, _CMP_GT_OQ);
+        _mm512_storeu_ps(po + 2*ind, _mm512_maskz_div_ps(keep, num, norm));
+    }
+    div_avx2(out+ind, a+ind, b+ind, n-ind, eps);
+}
+
+#pragma GCC diagnostic pop
+
+#endif  // WCT_X86_KERNELS
+
+struct Kernels {
+    mul_func mul;
+    mul_func mulc;
+    div_func div;
+};
+
+static const Kernels g_kernels[] = {
+    { mul_scalar<float>, mulc_scalar<float>, div_scalar<float> },
+#ifdef WCT_X86_KERNELS
+    { mul_sse4, mulc_sse4, div_sse4 },
+    { mul_avx2, mulc_avx2, div_avx2 },
+    { mul_avx512, mulc_avx512, div_avx512 },
+#endif
+};
+
+Level WireCell::ComplexKernels::best_level()
+{
+#ifdef WCT_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return avx512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return avx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return sse4;
+    }
+#endif
+    return scalar;
+}
+
+static std::atomic<int>& current()
+{
+    static std::atomic<int> lvl(best_level());
+    return lvl;
+}
+
+Level WireCell::ComplexKernels::level()
+{
+    return (Level)current().load();
+}
+
+Level WireCell::ComplexKernels::set_level(Level lvl)
+{
+    const Level best = best_level();
+    if (lvl < scalar || lvl > best) {
+        lvl = best;
+    }
+    current() = lvl;
+    return lvl;
+}
+
+std::string WireCell::ComplexKernels::level_name(Level lvl)
+{
+    switch (lvl) {
+    case sse4: return "sse4";
+    case avx2: return "avx2";
+    case avx512: return "avx512";
+    default: return "scalar";
+    }
+}
+
+void WireCell::ComplexKernels::multiply(std::complex<float>* out, const std::complex<float>* a,
+                                        const std::complex<float>* b, size_t n)
+{
+    g_kernels[current().load(std::memory_order_relaxed)].mul(out, a, b, n);
+}
+
+void WireCell::ComplexKernels::multiply_conj(std::complex<float>* out, const std::complex<float>* a,
+                                             const std::complex<float>* b, size_t n)
+{
+    g_kernels[current().load(std::memory_order_relaxed)].mulc(out, a, b, n);
+}
+
+void WireCell::ComplexKernels::divide(std::complex<float>* out, const std::complex<float>* a,
+                                      const std::complex<float>* b, size_t n, float eps)
+{
+    g_kernels[current().load(std::memory_order_relaxed)].div(out, a, b, n, eps);
+}
+
+void WireCell::ComplexKernels::multiply(std::complex<double>* out, const std::complex<double>* a,
+                                        const std::complex<double>* b, size_t n)
+{
+    mul_scalar(out, a, b, n);
+}
+
+void WireCell::ComplexKernels::multiply_conj(std::complex<double>* out, const std::complex<double>* a,
+                                             const std::complex<double>* b, size_t n)
+{
+    mulc_scalar(out, a, b, n);
+}
+
+void WireCell::ComplexKernels::divide(std::complex<double>* out, const std::complex<double>* a,
+                                      const std::complex<double>* b, size_t n, double eps)
+{
+    div_scalar(out, a, b, n, eps);
+}
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
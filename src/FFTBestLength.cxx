@@ -1,11 +1,124 @@
 #include "WireCellUtil/FFTBestLength.h"
+#include "WireCellUtil/FFTPlanCache.h"
+#include "WireCellUtil/Exceptions.h"
 
-#include <boost/assign/std/vector.hpp>
-#include <iostream>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
 
-using namespace boost::assign;
 using namespace WireCell;
 
+// Candidates considered in calibrated mode lie within this factor of
+// the smallest smooth length.
+static const double calibration_slack = 1.25;
+static const int calibration_maxcands = 16;
+
+// Guards the globals below.  It is never held while timing.
+static std::mutex g_mutex;
+static int g_max_prime = 7;
+static bool g_calibrate = false;
+// (nsamples, keep_odd_even, max_prime, calibrate) -> best length
+static std::map<std::tuple<size_t, bool, int, bool>, size_t> g_best;
+// length -> seconds per forward and inverse real transform
+static std::map<size_t, double> g_timing;
+
+bool WireCell::fft_smooth(size_t n, int max_prime)
+{
+    if (n == 0) {
+        return false;
+    }
+    static const int primes[] = {2, 3, 5, 7, 11, 13};
+    for (int prime : primes) {
+        if (prime > max_prime) {
+            break;
+        }
+        while (n % prime == 0) {
+            n /= prime;
+        }
+    }
+    return n == 1;
+}
+
+// Smallest smooth length not less than n, with parity of n if asked.
+static size_t next_smooth(size_t n, bool keep_odd_even, int max_prime)
+{
+    const size_t step = keep_odd_even ? 2 : 1;
+    while (!fft_smooth(n, max_prime)) {
+        n += step;
+    }
+    return n;
+}
+
+static double time_length(size_t n)
+{
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        auto it = g_timing.find(n);
+        if (it != g_timing.end()) {
+            return it->second;
+        }
+    }
+
+    std::vector<float> wave(n, 0.0);
+    for (size_t ind=0; ind<n; ++ind) {
+        wave[ind] = (ind*7919) % 101;
+    }
+    std::vector<std::complex<float> > spec(n/2+1);
+    auto& fft = FFTPlanCache::local();
+    fft.rfwd(spec.data(), 1, wave.data(), 1, n); // make plans
+    fft.rinv(wave.data(), 1, spec.data(), 1, n);
+
+    // repeat until a measurable amount of time has passed
+    int ntries = 0;
+    auto t1 = std::chrono::high_resolution_clock::now();
+    auto t2 = t1;
+    do {
+        fft.rfwd(spec.data(), 1, wave.data(), 1, n);
+        fft.rinv(wave.data(), 1, spec.data(), 1, n);
+        ++ntries;
+        t2 = std::chrono::high_resolution_clock::now();
+    } while (t2-t1 < std::chrono::milliseconds(2));
+    const double dt = std::chrono::duration<double>(t2-t1).count() / ntries;
+    // a concurrent timing of the same length may have won, keep it
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_timing.emplace(n, dt).first->second;
+}
+
+static size_t calibrated(size_t n, bool keep_odd_even, int max_prime)
+{
+    const size_t step = keep_odd_even ? 2 : 1;
+    const size_t first = next_smooth(n, keep_odd_even, max_prime);
+    const size_t last = first * calibration_slack;
+
+    size_t best = first;
+    double best_time = time_length(first);
+    int ncands = 1;
+    for (size_t cand = first+step; cand <= last && ncands < calibration_maxcands; cand += step) {
+        if (!fft_smooth(cand, max_prime)) {
+            continue;
+        }
+        ++ncands;
+        const double dt = time_length(cand);
+        if (dt < best_time) {
+            best = cand;
+            best_time = dt;
+        }
+    }
+    return best;
+}
+
+void WireCell::fft_best_length_config(int max_prime, bool calibrate)
+{
+    if (max_prime != 7 && max_prime != 11 && max_prime != 13) {
+        THROW(ValueError() << errmsg{"fft_best_length: max_prime must be 7, 11 or 13"});
+    }
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_max_prime = max_prime;
+    g_calibrate = calibrate;
+}
+
 // flag = 0, does not care if window_length is odd or even
 // flag = 1, if the window_length is odd, the returned value will be odd
 //           if the window_length is even, the returned value will be even
@@ -13,32 +126,33 @@ using namespace WireCell;
 std::size_t WireCell::fft_best_length(std::size_t window_length,
                                       bool keep_odd_even)
 {
+    if (window_length <= 1) {
+        return window_length;
+    }
+
+    int max_prime = 0;
+    bool calibrate = false;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        max_prime = g_max_prime;
+        calibrate = g_calibrate;
+        auto it = g_best.find(std::make_tuple(window_length, keep_odd_even, max_prime, calibrate));
+        if (it != g_best.end()) {
+            return it->second;
+        }
+    }
+
+    // Computed unlocked so calibration does not block other callers.
+    size_t best = 0;
+    if (calibrate) {
+        best = calibrated(window_length, keep_odd_even, max_prime);
+    }
+    else {
+        best = next_smooth(window_length, keep_odd_even, max_prime);
+    }
 
-  std::vector<std::size_t> edges;
-  if (!keep_odd_even) {
-    edges += 33, 35, 40, 42, 44, 56, 64, 66, 70, 77, 80, 96, 98, 100, 112, 121, 128, 140, 143, 160, 168, 169, 200, 224, 256, 280, 320, 400, 448, 512, 560, 640, 686, 768, 800, 847, 896, 1024, 1120, 1280, 1331, 1372, 1400, 1536, 1600, 1792, 2048, 2560, 2662, 2744, 3200, 3584, 4096, 4116, 4480, 4802, 5120, 5324, 5376, 5544, 5600, 5632, 5929, 6174, 6272, 6292, 6655, 7168, 7840, 8192, 8232, 8960, 9317, 10240, 10648, 11979, 14336, 15972, 16384;
-    // edges += 2, 4, 8, 16, 32, 33, 35, 40, 42, 44, 56, 64, 66, 70, 77, 80, 96, 98, 100, 112, 121, 128, 140, 143, 160, 168, 169, 200, 224, 256, 280, 320, 400, 448, 512, 560, 640, 686, 768, 800, 847, 896, 1024, 1120, 1280, 1331, 1372, 1400, 1536, 1600, 1792, 2048, 2560, 2662, 2744, 3200, 4096, 4116, 4480, 4802, 5120, 5324, 5376, 5544, 5600, 5632, 5929, 6174, 6272, 6292, 6655, 7168, 7840, 8192, 8232, 8960, 9317, 10240, 10648, 11979, 14336, 15972, 16384; 
-  }else{
-    if (window_length%2==0){
-      // even
-      edges += 40, 42, 44, 56, 64, 66, 70, 72, 80, 96, 98, 100, 112, 120, 128, 140, 160, 168, 200, 224, 256, 280, 320, 400, 448, 512, 560, 640, 686, 768, 800, 896, 1024, 1120, 1280, 1372, 1400, 1536, 1600, 1792, 2048, 2560, 2662, 2744, 3200, 3584, 4096, 4116, 4480, 4802, 5120, 5324, 5376, 5544, 5600, 5632, 6174, 6272, 6292, 6468, 7168, 7840, 8192, 8232, 8960, 10240, 10648, 11200, 11858, 11880, 14336, 15972, 16384;
-      //  edges += 2, 4, 8, 16, 32, 64, 128, 130, 200, 256, 280, 320, 400, 448, 512, 560, 686, 768, 800, 882, 960, 980, 1024, 1280, 1372, 1536, 1600, 1792, 2048, 2560, 2662, 2744, 3200, 4096, 4116, 4480, 4802, 5120, 5324, 5544, 5600, 5632, 6174, 6272, 6468, 7168, 7840, 8192, 8232, 8960, 10240, 10648, 14336, 15972, 16000, 16384;
-
-    }else{
-      // odd
-      edges += 33, 35, 39, 49, 55, 63, 65, 77, 81, 91, 99, 121, 143, 169, 175, 187, 225, 231, 245, 275, 297, 343, 363, 375, 385, 405, 441, 455, 495, 539, 605, 637, 693, 735, 847, 875, 891, 945, 1001, 1089, 1331, 1573, 1859, 1875, 2197, 2299, 2431, 2541, 2625, 2695, 3025, 3267, 3993, 4095, 4125, 4719, 4725, 5005, 5145, 5445, 5929, 6655, 7007, 7623, 7865, 9317, 9801, 11979, 14157, 14175, 15379, 16335;
-      // edges += 33, 35, 39, 49, 55, 63, 65, 77, 81, 91, 99, 121, 143, 169, 175, 187, 225, 231, 245, 275, 297, 343, 363, 375, 385, 405, 441, 455, 495, 539, 605, 637, 693, 735, 847, 875, 891, 945, 1001, 1089, 1331, 1573, 1859, 1875, 2197, 2299, 2431, 2541, 2625, 2695, 3025, 3267, 3993, 4095, 4125, 4719, 4725, 5005, 5145, 5445, 5929, 6655, 7007, 7623, 7865, 9317, 9801, 11979, 14157, 14175, 15379, 16335;
-    }
-  }
-
-  // std::cout << flag << " " << window_length << " " << edges.back() << std::endl;
-  
-  if (window_length <= edges.back()){
-    for (auto it = edges.begin(); it!=edges.end(); it++){
-      if ((*it) >= window_length)
-	return *it;
-    }
-  }
-  
-  return window_length;
+    // Publish, keeping any answer another thread got in first.
+    std::lock_guard<std::mutex> lock(g_mutex);
+    const auto key = std::make_tuple(window_length, keep_odd_even, max_prime, calibrate);
+    return g_best.emplace(key, best).first->second;
 }
@@ -0,0 +1,205 @@
+#include "WireCellUtil/FFTPlanCache.h"
+
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+
+using namespace WireCell;
+
+// Planning and plan destruction go through here.  Being constant
+// initialized, it outlives the thread pool and its thread caches.
+static std::mutex g_plan_mutex;
+static std::atomic<size_t> g_nplans(0);
+
+// Layout bits entering the plan key.  The FFTW backend makes
+// distinct plans for aligned and unaligned data.  In-place transforms
+// never reach the engine as they are routed through scratch.
+enum { layout_aligned=0, layout_unaligned=1 };
+
+FFTPlanCache& FFTPlanCache::local()
+{
+    static thread_local FFTPlanCache cache;
+    return cache;
+}
+
+size_t FFTPlanCache::nplans()
+{
+    return g_nplans;
+}
+
+// Scratch buffers matching the sample type.
+template<typename Vec>
+static typename Vec::value_type* scratch(Vec& vec, int n)
+{
+    if ((int)vec.size() < n) {
+	vec.resize(n);
+    }
+    return vec.data();
+}
+
+FFTPlanCache::FFTPlanCache()
+{
+}
+
+// Runs at thread exit, possibly in several pool workers at once, and
+// destroying an FFTW plan is no more thread safe than making one.
+FFTPlanCache::~FFTPlanCache()
+{
+    std::lock_guard<std::mutex> lock(g_plan_mutex);
+    m_rengine.impl().clear();
+    m_cengine.impl().clear();
+    m_drengine.impl().clear();
+    m_dcengine.impl().clear();
+}
+
+FFTPlanCache::real_t* FFTPlanCache::scratch_in(const real_t*, int n) { return scratch(m_rin, n); }
+FFTPlanCache::complex_t* FFTPlanCache::scratch_in(const complex_t*, int n) { return scratch(m_cin, n); }
+FFTPlanCache::real_t* FFTPlanCache::scratch_out(const real_t*, int n) { return scratch(m_rout, n); }
+FFTPlanCache::complex_t* FFTPlanCache::scratch_out(const complex_t*, int n) { return scratch(m_cout, n); }
+double* FFTPlanCache::scratch_in(const double*, int n) { return scratch(m_din, n); }
+std::complex<double>* FFTPlanCache::scratch_in(const std::complex<double>*, int n) { return scratch(m_zin, n); }
+double* FFTPlanCache::scratch_out(const double*, int n) { return scratch(m_dout, n); }
+std::complex<double>* FFTPlanCache::scratch_out(const std::complex<double>*, int n) { return scratch(m_zout, n); }
+
+// Dispatch to the engine method matching the sample types.
+template<typename T>
+static void run(Eigen::FFT<T>& engine, std::complex<T>* out, const T* in,
+		int n, bool /*inverse*/, bool half)
+{
+    if (half) { engine.impl().fwd(out, in, n); } // no reflection
+    else      { engine.fwd(out, in, n); }
+}
+template<typename T>
+static void run(Eigen::FFT<T>& engine, T* out, const std::complex<T>* in,
+		int n, bool /*inverse*/, bool /*half*/)
+{
+    // only ever reads the first n/2+1 bins
+    engine.inv(out, in, n);
+}
+template<typename T>
+static void run(Eigen::FFT<T>& engine, std::complex<T>* out, const std::complex<T>* in,
+		int n, bool inverse, bool /*half*/)
+{
+    if (inverse) { engine.inv(out, in, n); }
+    else         { engine.fwd(out, in, n); }
+}
+
+// The one-sample transform.
+template<typename T>
+static void identity(std::complex<T>& out, T in) { out = in; }
+template<typename T>
+static void identity(std::complex<T>& out, std::complex<T> in) { out = in; }
+template<typename T>
+static void identity(T& out, std::complex<T> in) { out = std::real(in); }
+
+template<typename Out, typename In>
+void FFTPlanCache::execute(Out* out, const In* in, int n, bool inverse, bool half)
+{
+    typedef typename Eigen::NumTraits<In>::Real real_type;
+    const bool real = !std::is_same<In, Out>::value;
+    auto& engine = this->engine(real_type(), real);
+    const bool dbl = std::is_same<real_type, double>::value;
+    int layout = layout_aligned;
+    if ((size_t)in % 16 || (size_t)out % 16) {
+	layout = layout_unaligned;
+    }
+    const key_t key(n, inverse, real, layout, dbl);
+    if (m_known.find(key) != m_known.end()) {
+	run(engine, out, in, n, inverse, half);
+	return;
+    }
+
+    std::lock_guard<std::mutex> lock(g_plan_mutex);
+    run(engine, out, in, n, inverse, half);
+    m_known.insert(key);
+    ++g_nplans;
+}
+
+template<typename Out, typename In>
+void FFTPlanCache::transform(Out* out, int ostride, int nout,
+			     const In* in, int istride, int nin,
+			     int n, bool inverse, bool half)
+{
+    if (n <= 0) {
+	return;
+    }
+    if (n == 1) {               // identity, and kissfft can not do it
+	identity(out[0], in[0]);
+	return;
+    }
+
+    // Contiguous and out of place: transform directly.
+    if (istride == 1 && ostride == 1 && (const void*)in != (const void*)out) {
+	execute(out, in, n, inverse, half);
+	return;
+    }
+
+    // Scratch always holds the full n samples as backends may use
+    // the space.
+    In* sin = scratch_in(in, n);
+    Out* sout = scratch_out(out, n);
+
+    for (int ind=0; ind<nin; ++ind) {
+	sin[ind] = in[ind*istride];
+    }
+    execute(sout, sin, n, inverse, half);
+    for (int ind=0; ind<nout; ++ind) {
+	out[ind*ostride] = sout[ind];
+    }
+}
+
+
+void FFTPlanCache::fwd(complex_t* out, int ostride, const real_t* in, int istride, int n)
+{
+    transform(out, ostride, n, in, istride, n, n, false, false);
+}
+void FFTPlanCache::fwd(complex_t* out, int ostride, const complex_t* in, int istride, int n)
+{
+    transform(out, ostride, n, in, istride, n, n, false, false);
+}
+void FFTPlanCache::inv(complex_t* out, int ostride, const complex_t* in, int istride, int n)
+{
+    transform(out, ostride, n, in, istride, n, n, true, false);
+}
+void FFTPlanCache::inv(real_t* out, int ostride, const complex_t* in, int istride, int n)
+{
+    transform(out, ostride, n, in, istride, n/2+1, n, true, false);
+}
+void FFTPlanCache::rfwd(complex_t* out, int ostride, const real_t* in, int istride, int n)
+{
+    transform(out, ostride, n/2+1, in, istride, n, n, false, true);
+}
+void FFTPlanCache::rinv(real_t* out, int ostride, const complex_t* in, int istride, int n)
+{
+    transform(out, ostride, n, in, istride, n/2+1, n, true, true);
+}
+
+void FFTPlanCache::fwd(std::complex<double>* out, int ostride, const double* in, int istride, int n)
+{
+    transform(out, ostride, n, in, istride, n, n, false, false);
+}
+void FFTPlanCache::fwd(std::complex<double>* out, int ostride, const std::complex<double>* in, int istride, int n)
+{
+    transform(out, ostride, n, in, istride, n, n, false, false);
+}
+void FFTPlanCache::inv(std::complex<double>* out, int ostride, const std::complex<double>* in, int istride, int n)
+{
+    transform(out, ostride, n, in, istride, n, n, true, false);
+}
+void FFTPlanCache::inv(double* out, int ostride, const std::complex<double>* in, int istride, int n)
+{
+    transform(out, ostride, n, in, istride, n/2+1, n, true, false);
+}
+void FFTPlanCache::rfwd(std::complex<double>* out, int ostride, const double* in, int istride, int n)
+{
+    transform(out, ostride, n/2+1, in, istride, n, n, false, true);
+}
+void FFTPlanCache::rinv(double* out, int ostride, const std::complex<double>* in, int istride, int n)
+{
+    transform(out, ostride, n, in, istride, n/2+1, n, true, true);
+}
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,109 @@
+#include "WireCellUtil/Parallel.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <vector>
+
+using namespace WireCell;
+
+static std::atomic<int> g_nthreads(1);
+
+void WireCell::Parallel::set_nthreads(int nthreads)
+{
+    g_nthreads = std::max(0, nthreads);
+}
+
+int WireCell::Parallel::nthreads()
+{
+    const int nthreads = g_nthreads;
+    if (nthreads == 0) {
+	return std::max(1u, std::thread::hardware_concurrency());
+    }
+    return nthreads;
+}
+
+int& WireCell::Parallel::depth()
+{
+    static thread_local int level = 0;
+    return level;
+}
+
+namespace {
+
+    // Persistent workers.  Worker i runs piece i+1 of each job.
+    class Pool {
+    public:
+        ~Pool() {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_wake.notify_all();
+            for (auto& th : m_threads) {
+                th.join();
+            }
+        }
+
+        void run(int npieces, void (*piece)(void*, int), void* context) {
+            std::lock_guard<std::mutex> submit(m_submit);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                while ((int)m_threads.size() < npieces-1) {
+                    m_threads.emplace_back(&Pool::work, this, m_threads.size(), m_generation);
+                }
+                m_piece = piece;
+                m_context = context;
+                m_npieces = npieces;
+                m_pending = npieces-1;
+                ++m_generation;
+            }
+            m_wake.notify_all();
+            piece(context, 0);
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_done.wait(lock, [this]() { return m_pending == 0; });
+        }
+
+    private:
+        void work(size_t iworker, unsigned long seen) {
+            const int ind = iworker + 1;
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (true) {
+                m_wake.wait(lock, [&]() { return m_stop || m_generation != seen; });
+                if (m_stop) {
+                    return;
+                }
+                seen = m_generation;
+                if (ind >= m_npieces) {
+                    continue;
+                }
+                lock.unlock();
+                m_piece(m_context, ind);
+                lock.lock();
+                if (--m_pending == 0) {
+                    m_done.notify_one();
+                }
+            }
+        }
+
+        std::mutex m_submit;    // one job at a time
+        std::mutex m_mutex;     // guards the rest
+        std::condition_variable m_wake, m_done;
+        std::vector<std::thread> m_threads;
+        void (*m_piece)(void*, int) = nullptr;
+        void* m_context = nullptr;
+        int m_npieces = 0, m_pending = 0;
+        unsigned long m_generation = 0;
+        bool m_stop = false;
+    };
+}
+
+void WireCell::Parallel::run_pieces(int npieces, void (*piece)(void*, int), void* context)
+{
+    static Pool pool;
+    pool.run(npieces, piece, context);
+}
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 4
+// End:
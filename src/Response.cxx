@@ -316,6 +316,7 @@ WireCell::Waveform::realseq_t Response::Generator::generate(const WireCell::Wave
     }
     return ret;
 }
+
 WireCell::Waveform::realseq_t Response::Generator::generate(const WireCell::Binning& tbins)
 {
     const int nsamples = tbins.nbins();
@@ -327,6 +328,17 @@ WireCell::Waveform::realseq_t Response::Generator::generate(const WireCell::Binn
     return ret;
 }
 
+WireCell::Waveform::realseq_t Response::Generator::half_spectrum(double max_freq, int nsamples) const
+{
+    const int nhalf = nsamples/2+1;
+    WireCell::Waveform::realseq_t ret(nhalf);
+    const double step = max_freq/nsamples;
+    for (int ind=0; ind < nhalf; ++ind) {
+	ret[ind] = (*this)(ind*step);
+    }
+    return ret;
+}
+
 
 
 
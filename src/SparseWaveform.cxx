@@ -0,0 +1,289 @@
+#include "WireCellUtil/SparseWaveform.h"
+#include "WireCellUtil/Exceptions.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace WireCell;
+using namespace WireCell::Waveform;
+
+SparseWave WireCell::Waveform::SparseWave::from_dense(Span<const real_t> wave, real_t threshold, size_t pad)
+{
+    const int size = wave.size();
+    const int npad = pad;
+    SparseWave ret(size);
+
+    // Scan for runs above threshold, widening and joining as we go.
+    BinRangeList runs;
+    int beg = -1;
+    auto found = [&](int first, int last) {
+        first = std::max(0, first - npad);
+        last = std::min(size, last + npad);
+        if (!runs.empty() && runs.back().second >= first) {
+            runs.back().second = last;
+            return;
+        }
+        runs.push_back(BinRange(first, last));
+    };
+    for (int ind = 0; ind < size; ++ind) {
+        const bool hot = std::abs(wave[ind]) > threshold;
+        if (hot && beg < 0) {
+            beg = ind;
+        }
+        else if (!hot && beg >= 0) {
+            found(beg, ind);
+            beg = -1;
+        }
+    }
+    if (beg >= 0) {
+        found(beg, size);
+    }
+
+    size_t total = 0;
+    for (const auto& run : runs) {
+        total += run.second - run.first;
+    }
+    ret.m_starts.reserve(runs.size());
+    ret.m_offsets.reserve(runs.size() + 1);
+    ret.m_samples.reserve(total);
+    for (const auto& run : runs) {
+        ret.m_starts.push_back(run.first);
+        for (int ind = run.first; ind < run.second; ++ind) {
+            ret.m_samples.push_back(wave[ind]);
+        }
+        ret.m_offsets.push_back(ret.m_samples.size());
+    }
+    return ret;
+}
+
+realseq_t WireCell::Waveform::SparseWave::dense() const
+{
+    realseq_t ret(m_nsamples, 0);
+    dense(ret);
+    return ret;
+}
+
+void WireCell::Waveform::SparseWave::dense(Span<real_t> wave) const
+{
+    if (wave.size() != m_nsamples) {
+        THROW(ValueError() << errmsg{"SparseWave: wrong dense size"});
+    }
+    size_t tick = 0;
+    for (size_t iseg = 0; iseg < m_starts.size(); ++iseg) {
+        const size_t start = m_starts[iseg], len = length(iseg);
+        const real_t* vals = samples(iseg);
+        for (; tick < start; ++tick) {
+            wave[tick] = 0;
+        }
+        for (size_t ind = 0; ind < len; ++ind) {
+            wave[start + ind] = vals[ind];
+        }
+        tick = start + len;
+    }
+    for (; tick < m_nsamples; ++tick) {
+        wave[tick] = 0;
+    }
+}
+
+BinRangeList WireCell::Waveform::SparseWave::ranges() const
+{
+    BinRangeList ret(m_starts.size());
+    for (size_t iseg = 0; iseg < m_starts.size(); ++iseg) {
+        ret[iseg] = BinRange(m_starts[iseg], m_starts[iseg] + length(iseg));
+    }
+    return ret;
+}
+
+real_t WireCell::Waveform::SparseWave::at(int tick) const
+{
+    auto it = std::upper_bound(m_starts.begin(), m_starts.end(), tick);
+    if (it == m_starts.begin()) {
+        return 0;
+    }
+    const size_t iseg = it - m_starts.begin() - 1;
+    const size_t ind = tick - m_starts[iseg];
+    if (ind >= length(iseg)) {
+        return 0;
+    }
+    return samples(iseg)[ind];
+}
+
+void WireCell::Waveform::SparseWave::add(int start, Span<const real_t> vals)
+{
+    if (start < 0 || start + vals.size() > m_nsamples) {
+        THROW(ValueError() << errmsg{"SparseWave: segment outside waveform"});
+    }
+    if (!vals.size()) {
+        return;
+    }
+    SparseWave one(m_nsamples);
+    one.m_starts.push_back(start);
+    one.m_samples.resize(vals.size());
+    for (size_t ind = 0; ind < vals.size(); ++ind) {
+        one.m_samples[ind] = vals[ind];
+    }
+    one.m_offsets.push_back(vals.size());
+    *this += one;
+}
+
+// Walk the segments of both in order of start, gathering those which
+// overlap or touch into one output segment and summing their samples.
+SparseWave& WireCell::Waveform::SparseWave::operator+=(const SparseWave& other)
+{
+    if (other.m_nsamples != m_nsamples) {
+        THROW(ValueError() << errmsg{"SparseWave: sizes differ"});
+    }
+    if (other.empty()) {
+        return *this;
+    }
+    const SparseWave& a = *this;
+    const SparseWave& b = other;
+    SparseWave ret(m_nsamples);
+    ret.m_starts.reserve(a.nsegments() + b.nsegments());
+    ret.m_offsets.reserve(a.nsegments() + b.nsegments() + 1);
+    ret.m_samples.reserve(a.occupancy() + b.occupancy());
+
+    const size_t na = a.nsegments(), nb = b.nsegments();
+    size_t ia = 0, ib = 0;
+    while (ia < na || ib < nb) {
+        const size_t ia0 = ia, ib0 = ib;
+        const bool froma = ib == nb || (ia < na && a.m_starts[ia] <= b.m_starts[ib]);
+        const int beg = froma ? a.m_starts[ia] : b.m_starts[ib];
+        int end = beg;
+        bool more = true;
+        while (more) {
+            more = false;
+            while (ia < na && a.m_starts[ia] <= end) {
+                end = std::max(end, int(a.m_starts[ia] + a.length(ia)));
+                ++ia;
+                more = true;
+            }
+            while (ib < nb && b.m_starts[ib] <= end) {
+                end = std::max(end, int(b.m_starts[ib] + b.length(ib)));
+                ++ib;
+                more = true;
+            }
+        }
+
+        const size_t off = ret.m_samples.size();
+        ret.m_starts.push_back(beg);
+        ret.m_samples.resize(off + end - beg, 0);
+        real_t* out = ret.m_samples.data() + off - beg;
+        for (size_t iseg = ia0; iseg < ia; ++iseg) {
+            const real_t* vals = a.samples(iseg);
+            for (size_t ind = 0, len = a.length(iseg); ind < len; ++ind) {
+                out[a.m_starts[iseg] + ind] += vals[ind];
+            }
+        }
+        for (size_t iseg = ib0; iseg < ib; ++iseg) {
+            const real_t* vals = b.samples(iseg);
+            for (size_t ind = 0, len = b.length(iseg); ind < len; ++ind) {
+                out[b.m_starts[iseg] + ind] += vals[ind];
+            }
+        }
+        ret.m_offsets.push_back(ret.m_samples.size());
+    }
+    *this = std::move(ret);
+    return *this;
+}
+
+SparseWave WireCell::Waveform::operator+(const SparseWave& a, const SparseWave& b)
+{
+    SparseWave ret(a);
+    ret += b;
+    return ret;
+}
+
+void WireCell::Waveform::SparseWave::increase(real_t scalar)
+{
+    for (auto& val : m_samples) {
+        val += scalar;
+    }
+}
+
+void WireCell::Waveform::SparseWave::scale(real_t scalar)
+{
+    for (auto& val : m_samples) {
+        val *= scalar;
+    }
+}
+
+real_t WireCell::Waveform::SparseWave::sum() const
+{
+    double ret = 0;
+    for (real_t val : m_samples) {
+        ret += val;
+    }
+    return ret;
+}
+
+real_t WireCell::Waveform::SparseWave::sum2() const
+{
+    double ret = 0;
+    for (real_t val : m_samples) {
+        ret += val*val;
+    }
+    return ret;
+}
+
+
+void WireCell::Waveform::SparseFrame::reindex()
+{
+    m_index.clear();
+    for (size_t ind = 0; ind < m_channels.size(); ++ind) {
+        if (!m_index.emplace(m_channels[ind], ind).second) {
+            THROW(ValueError() << errmsg{"SparseFrame: duplicate channel"});
+        }
+    }
+}
+
+void WireCell::Waveform::SparseFrame::size_mismatch(const char* what)
+{
+    THROW(ValueError() << errmsg{std::string("SparseFrame: ") + what});
+}
+
+int WireCell::Waveform::SparseFrame::index(int channel) const
+{
+    auto it = m_index.find(channel);
+    if (it == m_index.end()) {
+        return -1;
+    }
+    return it->second;
+}
+
+void WireCell::Waveform::SparseFrame::add(int channel, const SparseWave& wave)
+{
+    if (wave.size() != m_nticks) {
+        THROW(ValueError() << errmsg{"SparseFrame: wave size is not nticks"});
+    }
+    auto got = m_index.emplace(channel, m_channels.size());
+    if (!got.second) {
+        m_waves[got.first->second] += wave;
+        return;
+    }
+    m_channels.push_back(channel);
+    m_waves.push_back(wave);
+}
+
+size_t WireCell::Waveform::SparseFrame::occupancy() const
+{
+    size_t ret = 0;
+    for (const auto& wave : m_waves) {
+        ret += wave.occupancy();
+    }
+    return ret;
+}
+
+void WireCell::Waveform::SparseFrame::increase(real_t scalar)
+{
+    for (auto& wave : m_waves) {
+        wave.increase(scalar);
+    }
+}
+
+void WireCell::Waveform::SparseFrame::scale(real_t scalar)
+{
+    for (auto& wave : m_waves) {
+        wave.scale(scalar);
+    }
+}
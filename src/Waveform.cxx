@@ -1,10 +1,13 @@
 #include "WireCellUtil/Waveform.h"
+#include "WireCellUtil/BinRangeSet.h"
+#include "WireCellUtil/ComplexKernels.h"
+#include "WireCellUtil/Exceptions.h"
+#include "WireCellUtil/FFTBestLength.h"
+#include "WireCellUtil/FFTPlanCache.h"
 
 #include <algorithm>
-
-// for FFT
-#include <Eigen/Core>
-#include <unsupported/Eigen/FFT>
+#include <cmath>
+#include <set>
 
 #include <complex>
 
@@ -23,7 +26,16 @@ WireCell::Waveform::sub_sample(const Waveform::Domain& domain, int nsamples, con
 std::pair<double,double>
 WireCell::Waveform::mean_rms(const realseq_t& wf)
 {
-    const int n = wf.size();
+    return mean_rms(Span<const real_t>(wf));
+}
+
+// Sums are of differences from the first sample, which removes most
+// of any pedestal before squaring, accumulated in double.  A few
+// independent lanes let the compiler vectorize the loop.
+std::pair<double,double>
+WireCell::Waveform::mean_rms(Span<const real_t> wf)
+{
+    const size_t n = wf.size();
     if (n==0) {
 	return std::make_pair<double,double>(0,0);
     }
@@ -31,15 +43,42 @@ WireCell::Waveform::mean_rms(const realseq_t& wf)
 	return std::make_pair<double,double>(wf[0],0);
     }
 
-    // if left as float, numerical precision will lead to many NaN for
-    // the RMS due to sometimes subtracting similar sized numbers.
-    std::vector<double> wfd(wf.begin(), wf.end());
-
-    const double wsum = Waveform::sum(wfd);
-    const double w2sum = Waveform::sum2(wfd);
-    const double mean = wsum/n;
-    const double rms = sqrt( (w2sum - wsum*wsum/n) / n );
-    //   const double rms = sqrt( (w2sum - wsum*wsum/n) / (n-1) );
+    const int nlanes = 8;
+    double s1[nlanes] = {0}, s2[nlanes] = {0};
+    const double shift = wf[0];
+    const real_t* data = wf.data();
+    const size_t stride = wf.stride();
+    const size_t nfull = n - n % nlanes;
+    if (stride == 1) {
+        for (size_t ind = 0; ind < nfull; ind += nlanes) {
+            for (int lane = 0; lane < nlanes; ++lane) {
+                const double d = data[ind+lane] - shift;
+                s1[lane] += d;
+                s2[lane] += d*d;
+            }
+        }
+    }
+    else {
+        for (size_t ind = 0; ind < nfull; ind += nlanes) {
+            for (int lane = 0; lane < nlanes; ++lane) {
+                const double d = data[(ind+lane)*stride] - shift;
+                s1[lane] += d;
+                s2[lane] += d*d;
+            }
+        }
+    }
+    for (size_t ind = nfull; ind < n; ++ind) {
+        const double d = wf[ind] - shift;
+        s1[0] += d;
+        s2[0] += d*d;
+    }
+    double wsum = 0, w2sum = 0;
+    for (int lane = 0; lane < nlanes; ++lane) {
+        wsum += s1[lane];
+        w2sum += s2[lane];
+    }
+    const double mean = shift + wsum/n;
+    const double rms = sqrt(std::max(0.0, (w2sum - wsum*wsum/n) / n));
     return std::make_pair(mean,rms);
 }
 
@@ -75,9 +114,7 @@ Waveform::realseq_t WireCell::Waveform::phase(const Waveform::compseq_t& seq)
 
 Waveform::real_t WireCell::Waveform::median(Waveform::realseq_t wave)
 {
-    std::sort(wave.begin(), wave.end());
-    return wave[wave.size()/2];
-    //return percentile(wave,0.5);
+    return median_select(wave);
 }
 
 #include <iostream>
@@ -123,45 +160,281 @@ Waveform::real_t WireCell::Waveform::median_binned(Waveform::realseq_t& wave)
 
 Waveform::real_t WireCell::Waveform::percentile(Waveform::realseq_t wave, real_t percentage)
 {
-    std::sort(wave.begin(), wave.end());
-    return wave[wave.size() * percentage];
-}
-
-Waveform::real_t WireCell::Waveform::percentile_binned(Waveform::realseq_t& wave, real_t percentage){
-    const auto mm = std::minmax_element(wave.begin(), wave.end());
-    const auto vmin = *mm.first;
-    const auto vmax = *mm.second;
-    const int nbins = wave.size();
-    const auto binsize = (vmax-vmin)/nbins;
-    Waveform::realseq_t hist(nbins);
-    //std::cerr << "MEDIAN: (" << vmin << "," << vmax <<")/" << binsize << " with " << nbins << std::endl;
-    for (auto val : wave) {
-	int bin = int(round((val - vmin)/binsize));
-	bin = std::max(0, bin);
-	bin = std::min(nbins-1, bin);
-	hist[bin] += 1.0;
-	//std::cerr << "MEDIAN: " << bin << ":" << val << ", ";
-    }
-    //std::cerr << std::endl;
-    
-    // // debug
-    // for (auto count : hist) {
-    // 	if (!count) { continue; }
-    // 	std::cerr << count << " ";
-    // } std::cerr << std::endl;
-
-    const int imed = wave.size() * percentage;
-    int count = 0;
-    for (int ind=0; ind<nbins; ++ind) {
-	count += hist[ind];
-	if (count > imed) {
-	    float ret = vmin + ind*binsize;
-	    //std::cerr << "MEDIAN: [" << count << "] = " << ret << " vmin="<<vmin<<" vmax="<<vmax << " imed="<<imed<<std::endl;
-	    return ret;
-	}
+    return percentile_select(wave, percentage);
+}
+
+// Index into the sorted wave, as the original sorting versions.
+static size_t quantile_index(size_t size, Waveform::real_t percentage)
+{
+    const size_t ind = std::max<Waveform::real_t>(0, size * percentage);
+    return std::min(ind, size-1);
+}
+
+// Per-thread buffer for selecting in.
+static Waveform::realseq_t& select_buffer()
+{
+    static thread_local Waveform::realseq_t buf;
+    return buf;
+}
+
+// Copy of a span in the selection buffer.
+static Waveform::realseq_t& select_scratch(Waveform::Span<const Waveform::real_t> wave)
+{
+    Waveform::realseq_t& buf = select_buffer();
+    buf.resize(wave.size());
+    for (size_t ind = 0; ind < wave.size(); ++ind) {
+        buf[ind] = wave[ind];
+    }
+    return buf;
+}
+
+Waveform::real_t WireCell::Waveform::median_select(Waveform::realseq_t& wave)
+{
+    if (wave.empty()) {
+        return 0;
+    }
+    auto mid = wave.begin() + wave.size()/2;
+    std::nth_element(wave.begin(), mid, wave.end());
+    return *mid;
+}
+
+Waveform::real_t WireCell::Waveform::median_select(Span<const real_t> wave)
+{
+    return median_select(select_scratch(wave));
+}
+
+Waveform::real_t WireCell::Waveform::percentile_select(Waveform::realseq_t& wave, real_t percentage)
+{
+    if (wave.empty()) {
+        return 0;
+    }
+    auto nth = wave.begin() + quantile_index(wave.size(), percentage);
+    std::nth_element(wave.begin(), nth, wave.end());
+    return *nth;
+}
+
+Waveform::real_t WireCell::Waveform::percentile_select(Span<const real_t> wave, real_t percentage)
+{
+    return percentile_select(select_scratch(wave), percentage);
+}
+
+// Select in increasing index order, each selection only searching
+// above the previous one.
+std::vector<Waveform::real_t> WireCell::Waveform::percentiles(Waveform::realseq_t& wave,
+                                                              const std::vector<real_t>& percentages)
+{
+    const size_t nq = percentages.size();
+    std::vector<real_t> ret(nq, 0);
+    if (wave.empty()) {
+        return ret;
+    }
+    std::vector<std::pair<size_t, size_t> > order(nq); // (index, query)
+    for (size_t iq = 0; iq < nq; ++iq) {
+        order[iq] = std::make_pair(quantile_index(wave.size(), percentages[iq]), iq);
+    }
+    std::sort(order.begin(), order.end());
+
+    auto beg = wave.begin();
+    for (const auto& one : order) {
+        auto nth = wave.begin() + one.first;
+        if (nth >= beg) {
+            std::nth_element(beg, nth, wave.end());
+            beg = nth + 1;
+        }
+        ret[one.second] = *nth;
+    }
+    return ret;
+}
+
+std::vector<Waveform::real_t> WireCell::Waveform::percentiles(Span<const real_t> wave,
+                                                              const std::vector<real_t>& percentages)
+{
+    return percentiles(select_scratch(wave), percentages);
+}
+
+WireCell::Waveform::RollingQuantile::RollingQuantile(size_t window, size_t stride, real_t percentage)
+    : m_window(window)
+    , m_stride(stride)
+    , m_percentage(percentage)
+{
+    if (!window || !stride) {
+        THROW(ValueError() << errmsg{"RollingQuantile: window and stride must be positive"});
+    }
+}
+
+namespace {
+    // A multiset split so that lo holds the k+1 smallest values and
+    // its largest is the k'th order statistic.
+    class OrderWindow {
+    public:
+        void insert(Waveform::real_t val) {
+            if (!lo.empty() && val <= *lo.rbegin()) {
+                lo.insert(val);
+            }
+            else {
+                hi.insert(val);
+            }
+        }
+        void erase(Waveform::real_t val) {
+            if (!lo.empty() && val <= *lo.rbegin()) {
+                lo.erase(lo.find(val));
+            }
+            else {
+                hi.erase(hi.find(val));
+            }
+        }
+        Waveform::real_t kth(size_t k) {
+            while (lo.size() > k+1) {
+                auto last = std::prev(lo.end());
+                hi.insert(*last);
+                lo.erase(last);
+            }
+            while (lo.size() < k+1) {
+                lo.insert(*hi.begin());
+                hi.erase(hi.begin());
+            }
+            return *lo.rbegin();
+        }
+    private:
+        std::multiset<Waveform::real_t> lo, hi;
+    };
+}
+
+void WireCell::Waveform::RollingQuantile::operator()(Span<const real_t> wave, Span<real_t> out) const
+{
+    const long nsamples = wave.size();
+    if (out.size() != size(nsamples)) {
+        THROW(ValueError() << errmsg{"RollingQuantile: output has the wrong size"});
+    }
+    const long half = m_window/2;
+    auto window_of = [&](size_t iout) {
+        const long beg = (long)(iout*m_stride) - half;
+        return std::make_pair(std::max(0L, beg), std::min(nsamples, beg + (long)m_window));
+    };
+
+    // Windows barely overlap: select each one from scratch.
+    if (2*m_stride >= m_window) {
+        realseq_t& scratch = select_buffer();
+        for (size_t iout = 0; iout < out.size(); ++iout) {
+            const auto win = window_of(iout);
+            scratch.resize(win.second - win.first);
+            for (long ind = win.first; ind < win.second; ++ind) {
+                scratch[ind - win.first] = wave[ind];
+            }
+            out[iout] = percentile_select(scratch, m_percentage);
+        }
+        return;
+    }
+
+    OrderWindow ow;
+    long beg = 0, end = 0;      // current window
+    for (size_t iout = 0; iout < out.size(); ++iout) {
+        const auto win = window_of(iout);
+        for (; end < win.second; ++end) {
+            ow.insert(wave[end]);
+        }
+        for (; beg < win.first; ++beg) {
+            ow.erase(wave[beg]);
+        }
+        out[iout] = ow.kth(quantile_index(end - beg, m_percentage));
+    }
+}
+
+Waveform::realseq_t WireCell::Waveform::RollingQuantile::operator()(Span<const real_t> wave) const
+{
+    realseq_t ret(size(wave.size()));
+    (*this)(wave, ret);
+    return ret;
+}
+
+Waveform::real_t WireCell::Waveform::percentile_binned(Waveform::realseq_t& wave, real_t percentage)
+{
+    static thread_local QuantileHistogram hist;
+    hist.fill(wave);
+    return hist.quantile(percentage);
+}
+
+WireCell::Waveform::QuantileHistogram::QuantileHistogram(size_t nbins)
+    : m_nbins(nbins)
+    , m_wave(nullptr, 0)
+    , m_vmin(0), m_vmax(0), m_binsize(0)
+{
+}
+
+// Binning is monotonic in value so each bin holds a contiguous run
+// of the sorted wave.
+int WireCell::Waveform::QuantileHistogram::bin(real_t val) const
+{
+    const int nbins = m_cumulative.size();
+    int ind = int(std::round((val - m_vmin)/m_binsize));
+    ind = std::max(0, ind);
+    return std::min(nbins-1, ind);
+}
+
+void WireCell::Waveform::QuantileHistogram::fill(Span<const real_t> wave)
+{
+    m_wave = wave;
+    m_cumulative.clear();
+    if (!wave.size()) {
+        return;
+    }
+    m_vmin = m_vmax = wave[0];
+    for (size_t ind = 1; ind < wave.size(); ++ind) {
+        m_vmin = std::min(m_vmin, wave[ind]);
+        m_vmax = std::max(m_vmax, wave[ind]);
+    }
+    const size_t nbins = m_nbins ? m_nbins : wave.size();
+    m_binsize = (m_vmax - m_vmin)/nbins;
+    if (m_binsize <= 0) {       // all the same
+        m_cumulative.assign(1, wave.size());
+        return;
+    }
+    m_cumulative.assign(nbins, 0);
+    for (size_t ind = 0; ind < wave.size(); ++ind) {
+        ++m_cumulative[bin(wave[ind])];
+    }
+    for (size_t ind = 1; ind < nbins; ++ind) {
+        m_cumulative[ind] += m_cumulative[ind-1];
     }
-    // can't reach here, return bogus value.
-    return vmin + (vmax-vmin)*percentage;
+}
+
+Waveform::real_t WireCell::Waveform::QuantileHistogram::quantile(real_t percentage, bool refine) const
+{
+    if (m_cumulative.empty()) {
+        return 0;
+    }
+    if (m_cumulative.size() == 1) {
+        return m_vmin;
+    }
+    const int want = quantile_index(m_wave.size(), percentage);
+    const auto it = std::upper_bound(m_cumulative.begin(), m_cumulative.end(), want);
+    const int ibin = it - m_cumulative.begin();
+    if (!refine) {
+        return m_vmin + ibin*m_binsize;
+    }
+
+    const int before = ibin ? m_cumulative[ibin-1] : 0;
+    realseq_t& inbin = select_buffer();
+    inbin.clear();
+    for (size_t ind = 0; ind < m_wave.size(); ++ind) {
+        if (bin(m_wave[ind]) == ibin) {
+            inbin.push_back(m_wave[ind]);
+        }
+    }
+    auto nth = inbin.begin() + (want - before);
+    std::nth_element(inbin.begin(), nth, inbin.end());
+    return *nth;
+}
+
+std::vector<Waveform::real_t>
+WireCell::Waveform::QuantileHistogram::quantiles(const std::vector<real_t>& percentages, bool refine) const
+{
+    std::vector<real_t> ret;
+    ret.reserve(percentages.size());
+    for (auto pct : percentages) {
+        ret.push_back(quantile(pct, refine));
+    }
+    return ret;
 }
 
 
@@ -188,46 +461,352 @@ std::pair<int, int> WireCell::Waveform::edge(const realseq_t& wave)
 
 Waveform::compseq_t WireCell::Waveform::dft(realseq_t wave)
 {
-    auto v = Eigen::Map<Eigen::VectorXf>(wave.data(), wave.size());
-    Eigen::FFT<Waveform::real_t> trans;
-    Eigen::VectorXcf ret = trans.fwd(v);
-    return compseq_t(ret.data(), ret.data()+ret.size());
+    compseq_t ret(wave.size());
+    FFTPlanCache::local().fwd(ret.data(), 1, wave.data(), 1, wave.size());
+    return ret;
 }
 
 Waveform::realseq_t WireCell::Waveform::idft(compseq_t spec)
 {
-    Eigen::FFT<Waveform::real_t> trans;
-    auto v = Eigen::Map<Eigen::VectorXcf>(spec.data(), spec.size());
-    Eigen::VectorXf ret;
-    trans.inv(ret, v);
-    return realseq_t(ret.data(), ret.data()+ret.size());
+    realseq_t ret(spec.size());
+    FFTPlanCache::local().inv(ret.data(), 1, spec.data(), 1, spec.size());
+    return ret;
 }
 
-// Linear convolution, returns in1.size()+in2.size()-1.
-Waveform::realseq_t WireCell::Waveform::linear_convolve(Waveform::realseq_t in1,
-                                                        Waveform::realseq_t in2,
-                                                        bool truncate)
+template<typename Real>
+Waveform::Sequence<std::complex<Real> > WireCell::Waveform::dft(const Sequence<Real>& wave)
+{
+    Sequence<std::complex<Real> > ret(wave.size());
+    FFTPlanCache::local().fwd(ret.data(), 1, wave.data(), 1, wave.size());
+    return ret;
+}
+
+template<typename Real>
+Waveform::Sequence<Real> WireCell::Waveform::idft(const Sequence<std::complex<Real> >& spec)
+{
+    Sequence<Real> ret(spec.size());
+    FFTPlanCache::local().inv(ret.data(), 1, spec.data(), 1, spec.size());
+    return ret;
+}
+
+template Waveform::Sequence<std::complex<float> > WireCell::Waveform::dft<float>(const Sequence<float>&);
+template Waveform::Sequence<std::complex<double> > WireCell::Waveform::dft<double>(const Sequence<double>&);
+template Waveform::Sequence<float> WireCell::Waveform::idft<float>(const Sequence<std::complex<float> >&);
+template Waveform::Sequence<double> WireCell::Waveform::idft<double>(const Sequence<std::complex<double> >&);
+
+Waveform::realseq_t WireCell::Waveform::pad(const realseq_t& wave, int nsamples, PadType type)
+{
+    const int norig = wave.size();
+    if (nsamples <= norig) {
+        return wave;
+    }
+    realseq_t ret(nsamples, 0);
+    std::copy(wave.begin(), wave.end(), ret.begin());
+    if (type == pad_zero || norig == 0) {
+        return ret;
+    }
+    if (norig == 1) {
+        std::fill(ret.begin()+1, ret.end(), wave[0]);
+        return ret;
+    }
+    // reflect about the ends, excluding them, with period 2(n-1)
+    const int period = 2*(norig-1);
+    for (int ind=norig; ind<nsamples; ++ind) {
+        const int phase = ind % period;
+        ret[ind] = wave[phase < norig ? phase : period - phase];
+    }
+    return ret;
+}
+
+Waveform::compseq_t WireCell::Waveform::dft_padded(const realseq_t& wave, int& npad, PadType type)
+{
+    const int norig = wave.size();
+    npad = fft_best_length(norig) - norig;
+    return dft(pad(wave, norig + npad, type));
+}
+
+Waveform::realseq_t WireCell::Waveform::idft_cropped(const compseq_t& spec, int npad)
+{
+    if (npad < 0 || npad > (int)spec.size()) {
+        THROW(ValueError() << errmsg{"idft_cropped: npad out of range"});
+    }
+    realseq_t ret = idft(spec);
+    ret.resize(ret.size() - npad);
+    return ret;
+}
+
+// Per-thread scratch for the span functions.  Slot distinguishes
+// buffers of the same type.
+template<typename T, int slot>
+static T* scratch(size_t size)
+{
+    static thread_local std::vector<T> buf;
+    if (buf.size() < size) {
+        buf.resize(size);
+    }
+    return buf.data();
+}
+
+// Copy span into dst, zero padding to n samples.
+static void load(Waveform::real_t* dst, Waveform::Span<const Waveform::real_t> src, size_t n)
+{
+    const size_t nsrc = std::min(src.size(), n);
+    for (size_t ind = 0; ind < nsrc; ++ind) {
+        dst[ind] = src[ind];
+    }
+    std::fill(dst + nsrc, dst + n, 0);
+}
+
+void WireCell::Waveform::dft(Span<const real_t> wave, Span<complex_t> spec)
+{
+    if (spec.size() != wave.size()) {
+        THROW(ValueError() << errmsg{"dft: spectrum and wave sizes differ"});
+    }
+    FFTPlanCache::local().fwd(spec.data(), spec.stride(), wave.data(), wave.stride(), wave.size());
+}
+
+void WireCell::Waveform::idft(Span<const complex_t> spec, Span<real_t> wave)
+{
+    if (spec.size() != wave.size()) {
+        THROW(ValueError() << errmsg{"idft: spectrum and wave sizes differ"});
+    }
+    FFTPlanCache::local().inv(wave.data(), wave.stride(), spec.data(), spec.stride(), spec.size());
+}
+
+Waveform::compseq_t WireCell::Waveform::rfft(const realseq_t& wave)
+{
+    compseq_t ret(wave.size()/2+1);
+    rfft(wave, ret);
+    return ret;
+}
+
+Waveform::realseq_t WireCell::Waveform::irfft(const compseq_t& spec, int nsamples)
+{
+    realseq_t ret(nsamples);
+    irfft(spec, ret);
+    return ret;
+}
+
+void WireCell::Waveform::rfft(Span<const real_t> wave, Span<complex_t> spec)
+{
+    if (spec.size() != wave.size()/2+1) {
+        THROW(ValueError() << errmsg{"rfft: spectrum needs wave.size()/2+1 bins"});
+    }
+    if (wave.size() == 0) {
+        spec[0] = 0;
+        return;
+    }
+    FFTPlanCache::local().rfwd(spec.data(), spec.stride(), wave.data(), wave.stride(), wave.size());
+}
+
+void WireCell::Waveform::irfft(Span<const complex_t> spec, Span<real_t> wave)
 {
-    size_t n1_orig = in1.size(), n2_orig = in2.size();
-    size_t n_out = n1_orig + n2_orig - 1;
+    if (spec.size() != wave.size()/2+1) {
+        THROW(ValueError() << errmsg{"irfft: spectrum needs wave.size()/2+1 bins"});
+    }
+    FFTPlanCache::local().rinv(wave.data(), wave.stride(), spec.data(), spec.stride(), wave.size());
+}
 
-    in1.resize(n_out, 0);
-    in2.resize(n_out, 0);
+// Convolutions are done with half spectra.  The product of two
+// Hermitian spectra is Hermitian so nothing is lost.  The spectral
+// division of replace_convolve() makes its result depend on the
+// transform length so, unlike linear_convolve(), it keeps the
+// length of the original implementation.
+void WireCell::Waveform::linear_convolve(Span<const real_t> in1, Span<const real_t> in2,
+                                         Span<real_t> out)
+{
+    const size_t n1 = in1.size(), n2 = in2.size();
+    const size_t n = (n1 && n2) ? n1 + n2 - 1 : std::max(n1, n2);
+    if (out.size() > n) {
+        THROW(ValueError() << errmsg{"linear_convolve: output longer than the convolution"});
+    }
+    if (!n1 || !n2) {           // convolution with nothing
+        for (size_t ind = 0; ind < out.size(); ++ind) {
+            out[ind] = 0;
+        }
+        return;
+    }
+
+    // Any transform length from n up gives the linear convolution.
+    const size_t nfft = fft_best_length(n);
+    const size_t nhalf = nfft/2+1;
+    real_t* a = scratch<real_t, 0>(nfft);
+    real_t* b = scratch<real_t, 1>(nfft);
+    complex_t* sa = scratch<complex_t, 0>(nhalf);
+    complex_t* sb = scratch<complex_t, 1>(nhalf);
+    load(a, in1, nfft);
+    load(b, in2, nfft);
+
+    auto& fft = FFTPlanCache::local();
+    fft.rfwd(sa, 1, a, 1, nfft);
+    fft.rfwd(sb, 1, b, 1, nfft);
+    ComplexKernels::multiply(sa, sa, sb, nhalf);
+    fft.rinv(a, 1, sa, 1, nfft);
+
+    for (size_t ind = 0; ind < out.size(); ++ind) {
+        out[ind] = a[ind];
+    }
+}
+
+// With zero_vanishing, bins where the old response vanishes are
+// zeroed.  Otherwise they are divided through to inf or NaN as the
+// sequence form of replace_convolve() always has.
+static void replace_spectra(Waveform::Span<const Waveform::real_t> wave,
+                            Waveform::Span<const Waveform::real_t> newres,
+                            Waveform::Span<const Waveform::real_t> oldres,
+                            Waveform::Span<Waveform::real_t> out,
+                            bool zero_vanishing)
+{
+    const size_t sizes[3] = {wave.size(), newres.size(), oldres.size()};
+    const size_t total = sizes[0]+sizes[1]+sizes[2] - *std::min_element(sizes, sizes+3);
+    const size_t n = total ? total - 1 : 0;
+    if (out.size() > n) {
+        THROW(ValueError() << errmsg{"replace_convolve: output longer than the convolution"});
+    }
+    if (n == 0) {
+        return;
+    }
+
+    const size_t nhalf = n/2+1;
+    Waveform::real_t* a = scratch<Waveform::real_t, 0>(n);
+    Waveform::real_t* b = scratch<Waveform::real_t, 1>(n);
+    Waveform::real_t* c = scratch<Waveform::real_t, 2>(n);
+    Waveform::complex_t* sa = scratch<Waveform::complex_t, 0>(nhalf);
+    Waveform::complex_t* sb = scratch<Waveform::complex_t, 1>(nhalf);
+    Waveform::complex_t* sc = scratch<Waveform::complex_t, 2>(nhalf);
+    load(a, wave, n);
+    load(b, newres, n);
+    load(c, oldres, n);
+
+    auto& fft = FFTPlanCache::local();
+    fft.rfwd(sa, 1, a, 1, n);
+    fft.rfwd(sb, 1, b, 1, n);
+    fft.rfwd(sc, 1, c, 1, n);
+
+    ComplexKernels::multiply(sa, sa, sb, nhalf);
+    if (zero_vanishing) {
+        ComplexKernels::divide(sa, sa, sc, nhalf);
+    }
+    else {
+        for (size_t ind = 0; ind < nhalf; ++ind) {
+            sa[ind] /= sc[ind];
+        }
+    }
+    fft.rinv(a, 1, sa, 1, n);
+
+    for (size_t ind = 0; ind < out.size(); ++ind) {
+        out[ind] = a[ind];
+    }
+}
+
+void WireCell::Waveform::replace_convolve(Span<const real_t> wave, Span<const real_t> newres,
+                                          Span<const real_t> oldres, Span<real_t> out)
+{
+    replace_spectra(wave, newres, oldres, out, true);
+}
+
+WireCell::Waveform::Convolver::Convolver(size_t kernel_size, size_t max_size)
+    : m_nkern(kernel_size)
+    , m_nmax(max_size)
+    , m_nfft(fft_best_length(std::max<size_t>(1, m_nkern + m_nmax) - 1))
+    , m_spec(m_nfft/2+1)
+{
+    if (m_nkern == 0) {
+        THROW(ValueError() << errmsg{"Convolver: empty kernel"});
+    }
+}
+
+WireCell::Waveform::Convolver::Convolver(Span<const real_t> kernel, size_t max_size)
+    : Convolver(kernel.size(), max_size)
+{
+    real_t* a = scratch<real_t, 0>(m_nfft);
+    load(a, kernel, m_nfft);
+    FFTPlanCache::local().rfwd(m_spec.data(), 1, a, 1, m_nfft);
+}
+
+WireCell::Waveform::ResponseReplacer::ResponseReplacer(Span<const real_t> newres,
+                                                       Span<const real_t> oldres,
+                                                       size_t max_size, real_t regularization)
+    : Convolver(std::max(newres.size(), oldres.size()), max_size)
+{
+    const size_t nhalf = m_spec.size();
+    real_t* a = scratch<real_t, 0>(m_nfft);
+    complex_t* sold = scratch<complex_t, 0>(nhalf);
+    auto& fft = FFTPlanCache::local();
+    load(a, oldres, m_nfft);
+    fft.rfwd(sold, 1, a, 1, m_nfft);
+    load(a, newres, m_nfft);
+    fft.rfwd(m_spec.data(), 1, a, 1, m_nfft);
+
+    if (regularization <= 0) {
+        ComplexKernels::divide(m_spec.data(), m_spec.data(), sold, nhalf);
+        return;
+    }
+    real_t maxnorm = 0;
+    for (size_t ind = 0; ind < nhalf; ++ind) {
+        maxnorm = std::max(maxnorm, std::norm(sold[ind]));
+    }
+    const real_t reg = regularization * maxnorm;
+    // An all-zero old response leaves nothing to regularize with
+    // so, as with r = 0, its vanishing bins are zeroed.
+    ComplexKernels::multiply_conj(m_spec.data(), m_spec.data(), sold, nhalf);
+    for (size_t ind = 0; ind < nhalf; ++ind) {
+        const real_t denom = std::norm(sold[ind]) + reg;
+        m_spec[ind] = denom > 0 ? m_spec[ind] / denom : complex_t(0);
+    }
+}
 
-    auto v1 = Eigen::Map<Eigen::VectorXf>(in1.data(), in1.size());
-    auto v2 = Eigen::Map<Eigen::VectorXf>(in2.data(), in2.size());
+void WireCell::Waveform::Convolver::operator()(Span<const real_t> signal, Span<real_t> out) const
+{
+    if (signal.size() > m_nmax) {
+        THROW(ValueError() << errmsg{"Convolver: signal longer than the maximum"});
+    }
+    if (out.size() > signal.size() + m_nkern - 1) {
+        THROW(ValueError() << errmsg{"Convolver: output longer than the convolution"});
+    }
+    const size_t nhalf = m_spec.size();
+    real_t* a = scratch<real_t, 0>(m_nfft);
+    complex_t* sa = scratch<complex_t, 0>(nhalf);
+    load(a, signal, m_nfft);
 
-    Eigen::FFT<Waveform::real_t> trans;
+    auto& fft = FFTPlanCache::local();
+    fft.rfwd(sa, 1, a, 1, m_nfft);
+    ComplexKernels::multiply(sa, sa, m_spec.data(), nhalf);
+    fft.rinv(a, 1, sa, 1, m_nfft);
 
-    Eigen::VectorXcf s1 = trans.fwd(v1);
-    Eigen::VectorXcf s2 = trans.fwd(v2);
-    Eigen::VectorXcf s12 = (s1.array() * s2.array()).matrix();
-    Eigen::VectorXf vret;
-    trans.inv(vret, s12);
-    realseq_t ret(vret.data(), vret.data()+vret.size());
-    if (truncate) {
-        ret.resize(n1_orig);
+    for (size_t ind = 0; ind < out.size(); ++ind) {
+        out[ind] = a[ind];
     }
+}
+
+Waveform::realseq_t WireCell::Waveform::Convolver::operator()(Span<const real_t> signal, bool truncate) const
+{
+    realseq_t ret(truncate ? signal.size() : signal.size() + m_nkern - 1);
+    (*this)(signal, ret);
+    return ret;
+}
+
+void WireCell::Waveform::Convolver::operator()(const std::vector<realseq_t>& signals,
+                                               std::vector<realseq_t>& outs, bool truncate) const
+{
+    outs.resize(signals.size());
+    Parallel::for_range(signals.size(), [&](int beg, int end) {
+        for (int ind = beg; ind < end; ++ind) {
+            const size_t nsig = signals[ind].size();
+            outs[ind].resize(truncate ? nsig : nsig + m_nkern - 1);
+            (*this)(signals[ind], outs[ind]);
+        }
+    });
+}
+
+// Linear convolution, returns in1.size()+in2.size()-1.
+Waveform::realseq_t WireCell::Waveform::linear_convolve(Waveform::realseq_t in1,
+                                                        Waveform::realseq_t in2,
+                                                        bool truncate)
+{
+    const size_t n1 = in1.size(), n2 = in2.size();
+    realseq_t ret(truncate ? n1 : n1 + n2 - 1);
+    linear_convolve(in1, in2, ret);
     return ret;
 }
 
@@ -240,28 +819,200 @@ Waveform::realseq_t WireCell::Waveform::replace_convolve(Waveform::realseq_t wav
     size_t sizes[3] = {wave.size(), newres.size(), oldres.size()};
     size_t n_out = sizes[0]+sizes[1]+sizes[2] - *std::min_element(sizes, sizes+3) - 1;
 
-    wave.resize(n_out, 0);
-    newres.resize(n_out, 0);
-    oldres.resize(n_out, 0);
+    realseq_t ret(truncate ? sizes[0] : n_out);
+    replace_spectra(wave, newres, oldres, ret, false);
+    return ret;
+}
 
-    auto v1 = Eigen::Map<Eigen::VectorXf>(wave.data(),     wave.size());
-    auto v2 = Eigen::Map<Eigen::VectorXf>(newres.data(), newres.size());
-    auto v3 = Eigen::Map<Eigen::VectorXf>(oldres.data(), oldres.size());
 
-    Eigen::FFT<Waveform::real_t> trans;
+WireCell::Waveform::Resampler::Resampler(const Domain& domain, size_t nsamples,
+                                         const Domain& newdomain, size_t newnsamples,
+                                         Mode mode)
+    : m_mode(mode)
+    , m_nin(nsamples)
+    , m_nout(newnsamples)
+{
+    if (!nsamples || !newnsamples) {
+        THROW(ValueError() << errmsg{"Resampler: empty sampling"});
+    }
+    const double oldstep = sample_width(domain, nsamples);
+    const double step = sample_width(newdomain, newnsamples);
+    if (!(oldstep > 0) || !(step > 0)) {
+        THROW(ValueError() << errmsg{"Resampler: domains must have positive width"});
+    }
 
-    Eigen::VectorXcf s1 = trans.fwd(v1);
-    Eigen::VectorXcf s2 = trans.fwd(v2);
-    Eigen::VectorXcf s3 = trans.fwd(v3);
+    // For bandlimited, the cutoff as a fraction of the old Nyquist
+    // frequency and the sinc half width in old samples.
+    const double cutoff = std::min(1.0, oldstep/step);
+    const double halfwidth = sinc_lobes/cutoff;
 
-    Eigen::VectorXcf s123 = (s1.array() * s2.array() / s3.array()).matrix();
+    int lead = 0;               // taps before the one at or below t
+    switch (m_mode) {
+    case linear:
+        m_ntaps = 2;
+        break;
+    case cubic:
+        m_ntaps = 4;
+        lead = 1;
+        break;
+    case bandlimited:
+        lead = std::ceil(halfwidth) - 1;
+        m_ntaps = 2*(lead+1);
+        m_ntaps = 8*((m_ntaps+7)/8); // whole blocks, extra taps weigh zero
+        break;
+    default:
+        THROW(ValueError() << errmsg{"Resampler: unknown mode"});
+    }
+
+    m_first.resize(m_nout);
+    m_weights.resize(m_nout*m_ntaps, 0);
+    std::vector<double> wts(m_ntaps);
+    for (size_t iout = 0; iout < m_nout; ++iout) {
+        // position in old samples, clamped so the ends extend outward
+        double pos = (newdomain.first + iout*step - domain.first)/oldstep;
+        pos = std::max(0.0, std::min(pos, double(m_nin-1)));
+        const int ind = std::floor(pos);
+        const double frac = pos - ind;
+        m_first[iout] = ind - lead;
+
+        switch (m_mode) {
+        case linear:
+            wts[0] = 1-frac;
+            wts[1] = frac;
+            break;
+        case cubic:
+            wts[0] = 0.5*(-frac*frac*frac + 2*frac*frac - frac);
+            wts[1] = 0.5*(3*frac*frac*frac - 5*frac*frac + 2);
+            wts[2] = 0.5*(-3*frac*frac*frac + 4*frac*frac + frac);
+            wts[3] = 0.5*(frac*frac*frac - frac*frac);
+            break;
+        case bandlimited: {
+            double norm = 0;
+            for (size_t itap = 0; itap < m_ntaps; ++itap) {
+                const double dist = pos - (ind - lead + int(itap));
+                const double u = dist/halfwidth;
+                double wt = 0;
+                if (std::abs(u) < 1) {
+                    const double arg = M_PI*cutoff*dist;
+                    const double sinc = std::abs(arg) < 1e-12 ? 1.0 : std::sin(arg)/arg;
+                    wt = sinc*(0.42 + 0.5*std::cos(M_PI*u) + 0.08*std::cos(2*M_PI*u));
+                }
+                wts[itap] = wt;
+                norm += wt;
+            }
+            for (auto& wt : wts) {
+                wt /= norm;
+            }
+            break;
+        }
+        }
+        std::copy(wts.begin(), wts.end(), m_weights.begin() + iout*m_ntaps);
+    }
 
-    Eigen::VectorXf vret;
-    trans.inv(vret, s123);
-    realseq_t ret(vret.data(), vret.data()+vret.size());
-    if (truncate) {
-        ret.resize(sizes[0]);
+    // Taps only grow with output index so those entirely inside
+    // the wave are one range.
+    m_ibeg = m_nout;
+    m_iend = 0;
+    for (size_t iout = 0; iout < m_nout; ++iout) {
+        if (m_first[iout] >= 0 && m_first[iout] + m_ntaps <= m_nin) {
+            m_ibeg = std::min(m_ibeg, iout);
+            m_iend = iout + 1;
+        }
     }
+    if (m_ibeg > m_iend) {
+        m_ibeg = m_iend = 0;
+    }
+}
+
+// Dot products of a fixed number of taps for outputs [beg, end).
+template<size_t ntaps>
+static void resample_taps(const Waveform::real_t* in, const int* first, const Waveform::real_t* weights,
+                          Waveform::Span<Waveform::real_t> out, size_t beg, size_t end)
+{
+    for (size_t iout = beg; iout < end; ++iout) {
+        const Waveform::real_t* x = in + first[iout];
+        const Waveform::real_t* w = weights + iout*ntaps;
+        Waveform::real_t sum = 0;
+        for (size_t itap = 0; itap < ntaps; ++itap) {
+            sum += w[itap]*x[itap];
+        }
+        out[iout] = sum;
+    }
+}
+
+// Dot products of taps in blocks of 8, summed in 8 lanes.
+static void resample_blocks(const Waveform::real_t* in, const int* first, const Waveform::real_t* weights,
+                            size_t ntaps, Waveform::Span<Waveform::real_t> out, size_t beg, size_t end)
+{
+    const size_t nlanes = 8;
+    for (size_t iout = beg; iout < end; ++iout) {
+        const Waveform::real_t* x = in + first[iout];
+        const Waveform::real_t* w = weights + iout*ntaps;
+        Waveform::real_t acc[nlanes] = {0};
+        for (size_t itap = 0; itap < ntaps; itap += nlanes) {
+            for (size_t lane = 0; lane < nlanes; ++lane) {
+                acc[lane] += w[itap+lane]*x[itap+lane];
+            }
+        }
+        Waveform::real_t sum = 0;
+        for (size_t lane = 0; lane < nlanes; ++lane) {
+            sum += acc[lane];
+        }
+        out[iout] = sum;
+    }
+}
+
+void WireCell::Waveform::Resampler::operator()(Span<const real_t> wave, Span<real_t> out) const
+{
+    if (wave.size() != m_nin || out.size() != m_nout) {
+        THROW(ValueError() << errmsg{"Resampler: wrong wave or output size"});
+    }
+    const real_t* in = &wave[0];
+    if (wave.stride() != 1) {
+        real_t* buf = scratch<real_t, 3>(m_nin);
+        load(buf, wave, m_nin);
+        in = buf;
+    }
+
+    // Outputs with taps off either end take the end values.
+    auto clamped = [&](size_t beg, size_t end) {
+        for (size_t iout = beg; iout < end; ++iout) {
+            const real_t* w = m_weights.data() + iout*m_ntaps;
+            real_t sum = 0;
+            for (size_t itap = 0; itap < m_ntaps; ++itap) {
+                const int ind = std::max(0, std::min(m_first[iout] + int(itap), int(m_nin) - 1));
+                sum += w[itap]*in[ind];
+            }
+            out[iout] = sum;
+        }
+    };
+    clamped(0, m_ibeg);
+    switch (m_mode) {
+    case linear:
+        resample_taps<2>(in, m_first.data(), m_weights.data(), out, m_ibeg, m_iend);
+        break;
+    case cubic:
+        resample_taps<4>(in, m_first.data(), m_weights.data(), out, m_ibeg, m_iend);
+        break;
+    case bandlimited:
+        resample_blocks(in, m_first.data(), m_weights.data(), m_ntaps, out, m_ibeg, m_iend);
+        break;
+    }
+    clamped(m_iend, m_nout);
+}
+
+void WireCell::Waveform::Resampler::check_rows(size_t nrows_in, size_t ncols_in,
+                                               size_t nrows_out, size_t ncols_out) const
+{
+    if (nrows_in != nrows_out || ncols_in != m_nin || ncols_out != m_nout) {
+        THROW(ValueError() << errmsg{"Resampler: wrong input or output array shape"});
+    }
+}
+
+WireCell::Waveform::realseq_t WireCell::Waveform::Resampler::operator()(Span<const real_t> wave) const
+{
+    realseq_t ret(m_nout);
+    (*this)(wave, ret);
     return ret;
 }
 
@@ -269,21 +1020,7 @@ Waveform::realseq_t WireCell::Waveform::replace_convolve(Waveform::realseq_t wav
 WireCell::Waveform::BinRangeList
 WireCell::Waveform::merge(const WireCell::Waveform::BinRangeList& brl)
 {
-    WireCell::Waveform::BinRangeList tmp(brl.begin(), brl.end());
-    WireCell::Waveform::BinRangeList out;
-    sort(tmp.begin(), tmp.end());
-    Waveform::BinRange last_br = tmp[0];
-    out.push_back(last_br);
-
-    for (size_t ind=1; ind<tmp.size(); ++ind) {
-	Waveform::BinRange this_br = tmp[ind];
-	if (out.back().second >= this_br.first) {
-	  out.back().second = this_br.second;
-	  continue;
-	}
-	out.push_back(this_br);
-    }
-    return out;
+    return BinRangeSet(brl).ranges();
 }
 
 	/// Merge two bin range lists, forming a union from any overlapping ranges
@@ -291,11 +1028,7 @@ WireCell::Waveform::BinRangeList
 WireCell::Waveform::merge(const WireCell::Waveform::BinRangeList& br1,
 			  const WireCell::Waveform::BinRangeList& br2)
 {
-    WireCell::Waveform::BinRangeList out;
-    out.reserve(br1.size() + br2.size());
-    out.insert(out.end(), br1.begin(), br1.end());
-    out.insert(out.end(), br2.begin(), br2.end());
-    return merge(out);
+    return (BinRangeSet(br1) | BinRangeSet(br2)).ranges();
 }
 
 
@@ -306,12 +1039,7 @@ WireCell::Waveform::ChannelMasks
 WireCell::Waveform::merge(const WireCell::Waveform::ChannelMasks& one,
 			  const WireCell::Waveform::ChannelMasks& two)
 {
-    WireCell::Waveform::ChannelMasks out = one;
-    for (auto const &it : two) {
-	int ch = it.first;
-	out[ch] = merge(out[ch], it.second);
-    }
-    return out;
+    return (ChannelMaskSet(one) | ChannelMaskSet(two)).masks();
 }
 
 
@@ -319,30 +1047,50 @@ void WireCell::Waveform::merge(ChannelMaskMap &one,  ChannelMaskMap &two, std::m
 
     // loop over second map
     for (auto const& it: two){
-	std::string name = it.first;
-	std::string mapped_name;
-	if (name_map.find(name)!=name_map.end()){
-	    mapped_name = name_map[name];
-	}else{
-	    mapped_name = name;
-	}
-	if (one.find(mapped_name) != one.end()){
-	    one[mapped_name] = merge(one[mapped_name],it.second);
-	}else{
-	    one[mapped_name] = it.second;
+	auto nit = name_map.find(it.first);
+	const std::string& mapped_name = nit == name_map.end() ? it.first : nit->second;
+	auto got = one.emplace(mapped_name, it.second);
+	if (!got.second) {
+	    ChannelMasks& cm = got.first->second;
+	    cm = merge(cm, it.second);
 	}
     }
 }
 
 short WireCell::Waveform::most_frequent(const std::vector<short>& vals)
 {
-    const size_t nbins = 1<<16;
-    std::vector<unsigned int> hist(nbins, 0);
-    for (unsigned short val : vals) {
-	hist[val] += 1;
+    return most_frequent(Span<const short>(vals));
+}
+
+// The histogram is per thread and all zero between calls.  Only the
+// range of values seen is scanned and cleared.  Ties go to the value
+// which is smallest when taken as unsigned, as the full 65536 bin
+// scan of the original implementation did.
+short WireCell::Waveform::most_frequent(Span<const short> vals)
+{
+    const int offset = 1<<15;
+    static thread_local std::vector<unsigned int> hist(1<<16, 0);
+    if (!vals.size()) {
+        return 0;
+    }
+    int vmin = vals[0], vmax = vals[0];
+    for (size_t ind = 0; ind < vals.size(); ++ind) {
+        const int val = vals[ind];
+        ++hist[val + offset];
+        vmin = std::min(vmin, val);
+        vmax = std::max(vmax, val);
+    }
+    int best = vmin;
+    unsigned int nbest = 0;
+    for (int val = vmin; val <= vmax; ++val) {
+        const unsigned int count = hist[val + offset];
+        if (count > nbest || (count == nbest && (unsigned short)val < (unsigned short)best)) {
+            best = val;
+            nbest = count;
+        }
     }
-    auto it = std::max_element(hist.begin(), hist.end());
-    return it - hist.begin();	// casts back to signed short
+    std::fill(hist.begin() + vmin + offset, hist.begin() + vmax + offset + 1, 0);
+    return best;
 }
 
 
@@ -1,4 +1,5 @@
 #include "WireCellUtil/Array.h"
+#include "WireCellUtil/Exceptions.h"
 #include "WireCellUtil/ExecMon.h"
 #include "WireCellUtil/Testing.h"
 
@@ -161,6 +162,59 @@ void test_deconv(ExecMon& em)
     Assert(norm < 0.001);
 }
 
+void test_half(ExecMon& em)
+{
+    // odd and even number of columns
+    for (int ncols : {1000, 999}) {
+        const int nrows = 300;
+        auto arr = my_great_array(em, nrows, ncols);
+        const int nhalf = ncols/2+1;
+
+        auto spec = dft(arr);
+        auto half = rdft(arr);
+        Assert(half.rows() == nrows);
+        Assert(half.cols() == nhalf);
+        Assert(same(array_xxc(spec.leftCols(nhalf)), half));
+
+        auto arr2 = irdft(half, ncols);
+        Assert(arr2.cols() == ncols);
+        Assert(same(arr, arr2));
+
+        array_xxc filt = Eigen::ArrayXXcf::Random(nrows, ncols);
+        auto deco = deconv(arr, filt);
+        auto rdeco = rdeconv(arr, filt.leftCols(nhalf));
+        Assert(same(deco, rdeco, 1e-5));
+
+        // widths must match
+        int ncaught = 0;
+        try { irdft(half, ncols+2); } catch (const ValueError&) { ++ncaught; }
+        array_xxc wide = half;
+        try { irdft(wide, ncols-2, arr2); } catch (const ValueError&) { ++ncaught; }
+        try { rdeconv(arr, filt); } catch (const ValueError&) { ++ncaught; }
+        Assert(ncaught == 3);
+        em("half: checked");
+
+        const int nrounds = 20;
+        for (int count = 0; count < nrounds; ++count) {
+            auto tmp = deconv(arr, filt);
+        }
+        em("half: full deconv");
+        array_xxc hfilt = filt.leftCols(nhalf);
+        for (int count = 0; count < nrounds; ++count) {
+            auto tmp = rdeconv(arr, hfilt);
+        }
+        em("half: half-spectrum deconv");
+    }
+
+    // no columns at all
+    array_xxf empty(300, 0);
+    auto espec = rdft(empty);
+    Assert(espec.rows() == 300 && espec.cols() == 1);
+    Assert(espec.abs().maxCoeff() == 0.0);
+    auto edeco = rdeconv(empty, array_xxc(Eigen::ArrayXXcf::Ones(300, 1)));
+    Assert(edeco.rows() == 300 && edeco.cols() == 0);
+}
+
 void test_division(ExecMon& em)
 {
     array_xxf arr1(3,2), arr2(3,2), arr3(3,2);
@@ -227,6 +281,7 @@ int main()
     test_return(em);
     test_dft(em);
     test_deconv(em);
+    test_half(em);
     test_division(em);
     test_division_complex(em);
     
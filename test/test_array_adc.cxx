@@ -0,0 +1,85 @@
+#include "WireCellUtil/Array.h"
+#include "WireCellUtil/Exceptions.h"
+#include "WireCellUtil/Testing.h"
+
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace WireCell;
+using namespace WireCell::Array;
+
+array_xxs adc_frame(int nrows, int ncols, std::vector<float>& pedestals)
+{
+    std::default_random_engine re(ncols);
+    std::normal_distribution<> noise(0, 3);
+    std::uniform_int_distribution<> base(400, 2000);
+    pedestals.resize(nrows);
+    array_xxs adc(nrows, ncols);
+    for (int irow = 0; irow < nrows; ++irow) {
+        pedestals[irow] = base(re) + 0.25;
+        for (int icol = 0; icol < ncols; ++icol) {
+            adc(irow, icol) = pedestals[irow] + noise(re);
+        }
+    }
+    return adc;
+}
+
+void test_same(int nrows, int ncols)
+{
+    std::vector<float> peds;
+    array_xxs adc = adc_frame(nrows, ncols, peds);
+
+    array_xxf arr = adc.cast<float>();
+    for (int irow = 0; irow < nrows; ++irow) {
+        arr.row(irow) -= peds[irow];
+    }
+
+    Assert((dft(adc, peds) == dft(arr)).all());
+    array_xxc half;
+    rdft(adc, peds, half);
+    Assert((half == rdft(arr)).all());
+
+    // no pedestals
+    Assert((dft(adc, std::vector<float>()) == dft(array_xxf(adc.cast<float>()))).all());
+
+    bool caught = false;
+    try {
+        dft(adc, std::vector<float>(nrows+1, 0.0));
+    }
+    catch (const ValueError&) {
+        caught = true;
+    }
+    Assert(caught);
+}
+
+void test_speed(int nrows, int ncols)
+{
+    std::vector<float> peds;
+    array_xxs adc = adc_frame(nrows, ncols, peds);
+    array_xxf arr;
+    array_xxc spec;
+    rdft(adc, peds, spec);      // warm up
+
+    double t_copy = 1e9, t_fused = 1e9;
+    for (int count = 0; count < 3; ++count) {
+        t_copy = std::min(t_copy, Testing::time_ms([&]() {
+                    arr = adc.cast<float>();
+                    for (int irow = 0; irow < nrows; ++irow) {
+                        arr.row(irow) -= peds[irow];
+                    }
+                    rdft(arr, spec);
+                }));
+        t_fused = std::min(t_fused, Testing::time_ms([&]() { rdft(adc, peds, spec); }));
+    }
+    cerr << "rdft of ADC (" << nrows << "," << ncols << "): "
+         << "via float copy: " << t_copy << " ms, fused: " << t_fused << " ms" << endl;
+}
+
+int main()
+{
+    test_same(40, 100);
+    test_same(17, 33);
+    test_speed(800, 6000);
+    return 0;
+}
@@ -0,0 +1,126 @@
+// Check that steady-state use of the output-parameter and in-place
+// Array functions performs no heap allocation.
+
+#include "WireCellUtil/Array.h"
+#include "WireCellUtil/Exceptions.h"
+#include "WireCellUtil/Parallel.h"
+#include "WireCellUtil/Testing.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+using namespace std;
+using namespace WireCell;
+using namespace WireCell::Array;
+
+static std::atomic<size_t> g_nallocs(0);
+
+// Count every heap allocation.  Both operator new and Eigen go
+// through malloc() so interpose that (glibc only) and fall back to
+// counting operator new elsewhere.
+#ifdef __GLIBC__
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t num, size_t size);
+    void* __libc_realloc(void* ptr, size_t size);
+
+    void* malloc(size_t size)
+    {
+        ++g_nallocs;
+        return __libc_malloc(size);
+    }
+    void* calloc(size_t num, size_t size)
+    {
+        ++g_nallocs;
+        return __libc_calloc(num, size);
+    }
+    void* realloc(void* ptr, size_t size)
+    {
+        ++g_nallocs;
+        return __libc_realloc(ptr, size);
+    }
+}
+#else
+void* operator new(std::size_t size)
+{
+    ++g_nallocs;
+    void* ptr = std::malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+#endif
+
+void test_noalloc(int nthreads)
+{
+    Parallel::set_nthreads(nthreads);
+    const int nrows = 100, ncols = 999, nevents = 5;
+
+    array_xxf frame = Eigen::ArrayXXf::Random(nrows, ncols);
+    array_xxc filt = Eigen::ArrayXXcf::Random(nrows, ncols);
+    array_xxc hfilt = filt.leftCols(ncols/2+1);
+    const array_xxf want = deconv(frame, filt);
+    const array_xxf rwant = rdeconv(frame, hfilt);
+
+    array_xxf arr, back;
+    array_xxc spec;
+    Workspace ws, rws;
+
+    // warm up: sizes everything and makes plans
+    arr = frame;
+    deconv(arr, filt, ws);
+    arr = frame;
+    rdeconv(arr, hfilt, rws);
+    dft(frame, spec);
+    idft(spec, back);
+
+    const size_t nallocs = g_nallocs;
+    Assert(nallocs > 0);        // the counter works
+    for (int ievent = 0; ievent < nevents; ++ievent) {
+        arr = frame;
+        deconv(arr, filt, ws);
+        Assert((arr - want).abs().maxCoeff() < 1e-5);
+
+        arr = frame;
+        rdeconv(arr, hfilt, rws);
+        Assert((arr - rwant).abs().maxCoeff() < 1e-5);
+
+        dft(frame, spec);
+        idft(spec, back);
+        Assert((back - frame).abs().maxCoeff() < 1e-5);
+    }
+    const size_t nnew = g_nallocs - nallocs;
+    cerr << "allocations in " << nevents << " events with "
+         << nthreads << " threads: " << nnew << endl;
+    Assert(nnew == 0);
+
+    bool caught = false;
+    try {
+        array_xxc bad = Eigen::ArrayXXcf::Zero(nrows, ncols+1);
+        deconv(arr, bad, ws);
+    }
+    catch (const ValueError&) {
+        caught = true;
+    }
+    Assert(caught);
+    Parallel::set_nthreads(1);
+}
+
+int main()
+{
+    test_noalloc(1);
+    // pool workers keep their scratch and plans between calls
+    test_noalloc(4);
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "WireCellUtil/Array.h"
+#include "WireCellUtil/FFTPlanCache.h"
+#include "WireCellUtil/Parallel.h"
+#include "WireCellUtil/Testing.h"
+
+#include <iostream>
+#include <thread>
+
+using namespace std;
+using namespace WireCell;
+using namespace WireCell::Array;
+
+template<typename ArrType>
+void assert_identical(const ArrType& a, const ArrType& b)
+{
+    Assert(a.rows() == b.rows());
+    Assert(a.cols() == b.cols());
+    Assert((a == b).all());
+}
+
+void test_identical(int nrows, int ncols, int nthreads)
+{
+    array_xxf arr = Eigen::ArrayXXf::Random(nrows, ncols);
+    array_xxc filt = Eigen::ArrayXXcf::Random(nrows, ncols);
+    array_xxc hfilt = filt.leftCols(ncols/2+1);
+
+    Parallel::set_nthreads(1);
+    auto spec = dft(arr);
+    auto back = idft(spec);
+    auto part = dft_cc(dft_rc(arr, 0), 1);
+    auto deco = deconv(arr, filt);
+    auto rdeco = rdeconv(arr, hfilt);
+
+    Parallel::set_nthreads(nthreads);
+    assert_identical(spec, dft(arr));
+    assert_identical(back, idft(spec));
+    assert_identical(part, dft_cc(dft_rc(arr, 0), 1));
+    assert_identical(deco, deconv(arr, filt));
+    assert_identical(rdeco, rdeconv(arr, hfilt));
+    cerr << "(" << nrows << "," << ncols << ") identical with "
+         << Parallel::nthreads() << " threads" << endl;
+    Parallel::set_nthreads(1);
+}
+
+void test_speed(int nrows, int ncols)
+{
+    array_xxf arr = Eigen::ArrayXXf::Random(nrows, ncols);
+    array_xxc filt = Eigen::ArrayXXcf::Random(nrows, ncols);
+
+    const int nhw = std::max(1u, std::thread::hardware_concurrency());
+    for (int nthreads=1; nthreads <= nhw; nthreads *= 2) {
+        Parallel::set_nthreads(nthreads);
+        const double dt = Testing::time_ms([&]() { deconv(arr, filt); });
+        cerr << "deconv(" << nrows << "," << ncols << ") with "
+             << nthreads << " threads: " << dt << " ms" << endl;
+    }
+    Parallel::set_nthreads(1);
+}
+
+// Pool workers persist so their plan caches are reused.
+void test_plans(int nthreads)
+{
+    Parallel::set_nthreads(nthreads);
+    array_xxf arr = Eigen::ArrayXXf::Random(64, 256);
+    auto want = dft(arr);
+    const size_t nplans = FFTPlanCache::nplans();
+    for (int count = 0; count < 5; ++count) {
+        assert_identical(want, dft(arr));
+    }
+    cerr << "new plans over 5 dft calls with " << nthreads << " threads: "
+         << FFTPlanCache::nplans() - nplans << endl;
+    Assert(FFTPlanCache::nplans() == nplans);
+    Parallel::set_nthreads(1);
+}
+
+void test_range()
+{
+    // every index visited exactly once, whatever the split
+    for (int nthreads : {1, 2, 3, 7, 100}) {
+        std::vector<int> seen(10, 0);
+        Parallel::for_range(seen.size(), [&](int beg, int end) {
+                for (int ind=beg; ind<end; ++ind) { ++seen[ind]; }
+            }, nthreads);
+        for (int count : seen) {
+            Assert(count == 1);
+        }
+    }
+
+    bool caught = false;
+    try {
+        Parallel::for_range(10, [](int beg, int /*end*/) {
+                if (beg > 0) { throw std::runtime_error("bad piece"); }
+            }, 4);
+    }
+    catch (const std::runtime_error&) {
+        caught = true;
+    }
+    Assert(caught);
+}
+
+int main()
+{
+    test_range();
+    test_plans(4);
+    test_identical(300, 1000, 4);
+    test_identical(37, 101, 3);
+    test_identical(5, 8, 16);
+    test_speed(800, 6000);
+    return 0;
+}
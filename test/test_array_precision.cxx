@@ -0,0 +1,74 @@
+#include "WireCellUtil/Array.h"
+#include "WireCellUtil/Waveform.h"
+#include "WireCellUtil/Testing.h"
+
+#include <iostream>
+
+using namespace std;
+using namespace WireCell;
+using namespace WireCell::Array;
+
+void test_roundtrip()
+{
+    const int nrows = 48, ncols = 1001;
+    array_xxd arr = array_xxd::Random(nrows, ncols);
+
+    array_xxcd spec = dft(arr);
+    array_xxd back = idft(spec);
+    const double derr = (back - arr).abs().maxCoeff();
+
+    array_xxf farr = arr.cast<float>();
+    array_xxf fback = idft(dft(farr));
+    const double ferr = (fback - farr).abs().maxCoeff();
+
+    cerr << "round trip error, double: " << derr << " float: " << ferr << endl;
+    Assert(derr < 1e-12);
+    Assert(ferr > derr);
+
+    // half spectrum
+    array_xxcd half = rdft(arr);
+    Assert(half.cols() == ncols/2+1);
+    Assert((half - spec.leftCols(ncols/2+1)).abs().maxCoeff() < 1e-9);
+    Assert((irdft(half, ncols) - arr).abs().maxCoeff() < 1e-12);
+
+    // float and double agree to float precision
+    array_xxc fspec = dft(farr);
+    Assert((fspec.cast<std::complex<double> >() - spec).abs().maxCoeff() < 1e-2);
+}
+
+void test_deconv()
+{
+    const int nrows = 20, ncols = 300;
+    array_xxd arr = array_xxd::Random(nrows, ncols);
+    array_xxcd filter = dft(array_xxd(array_xxd::Random(nrows, ncols)));
+
+    array_xxd full = deconv(arr, filter);
+    array_xxd half = rdeconv(arr, array_xxcd(filter.leftCols(ncols/2+1)));
+    Assert((full - half).abs().maxCoeff() < 1e-9);
+
+    BasicWorkspace<double> ws;
+    array_xxd inplace = arr;
+    deconv(inplace, filter, ws);
+    Assert((inplace - full).abs().maxCoeff() == 0);
+}
+
+void test_waveform()
+{
+    std::vector<double> wave(100);
+    for (size_t ind = 0; ind < wave.size(); ++ind) {
+        wave[ind] = std::sin(0.1*ind) + 1e-9*ind;
+    }
+    auto spec = Waveform::dft(wave);
+    auto back = Waveform::idft(spec);
+    for (size_t ind = 0; ind < wave.size(); ++ind) {
+        Assert(std::abs(back[ind] - wave[ind]) < 1e-13);
+    }
+}
+
+int main()
+{
+    test_roundtrip();
+    test_deconv();
+    test_waveform();
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "WireCellUtil/Array.h"
+#include "WireCellUtil/Exceptions.h"
+#include "WireCellUtil/Testing.h"
+
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace WireCell;
+using namespace WireCell::Array;
+
+// A frame with the given fraction of rows carrying signal.
+array_xxf sparse_frame(int nrows, int ncols, double occupancy)
+{
+    std::default_random_engine re(nrows);
+    std::uniform_real_distribution<> dist(0, 1);
+    array_xxf arr = array_xxf::Zero(nrows, ncols);
+    for (int irow = 0; irow < nrows; ++irow) {
+        if (dist(re) < occupancy) {
+            const int beg = dist(re)*ncols;
+            const int len = std::min(ncols-beg, 50);
+            arr.row(irow).segment(beg, len).setRandom();
+        }
+    }
+    return arr;
+}
+
+void test_same(int nrows, int ncols, double occupancy)
+{
+    array_xxf arr = sparse_frame(nrows, ncols, occupancy);
+    auto rows = active_rows(arr);
+    for (int irow = 0, ind = 0; irow < nrows; ++irow) {
+        const bool active = (arr.row(irow) != 0.0f).any();
+        if (active) {
+            Assert(rows[ind++] == irow);
+        }
+    }
+
+    auto want = dft(arr);
+    auto got = dft_sparse(arr);
+    Assert((want == got).all());
+
+    array_xxc hspec;
+    rdft(arr, hspec, rows);
+    Assert((rdft(arr) == hspec).all());
+
+    array_xxc filt = Eigen::ArrayXXcf::Random(nrows, ncols);
+    array_xxf deco = arr;
+    Workspace ws;
+    deconv(deco, filt, ws, rows);
+    Assert((deco == deconv(arr, filt)).all());
+
+    array_xxc hfilt = filt.leftCols(ncols/2+1);
+    array_xxf rdeco = arr;
+    rdeconv(rdeco, hfilt, ws, rows);
+    Assert((rdeco == rdeconv(arr, hfilt)).all());
+}
+
+void test_errors()
+{
+    array_xxf arr = array_xxf::Zero(4, 8);
+    array_xxc spec;
+    bool caught = false;
+    try {
+        dft(arr, spec, std::vector<int>{0, 4});
+    }
+    catch (const IndexError&) {
+        caught = true;
+    }
+    Assert(caught);
+
+    // unsorted and duplicate lists are rejected, for every form
+    array_xxc filt = array_xxc::Ones(4, 8);
+    array_xxc hfilt = filt.leftCols(5);
+    Workspace ws;
+    for (const std::vector<int>& rows : {std::vector<int>{0, 3, 2}, std::vector<int>{1, 1, 3}}) {
+        int ncaught = 0;
+        try { dft(arr, spec, rows); } catch (const ValueError&) { ++ncaught; }
+        try { rdft(arr, spec, rows); } catch (const ValueError&) { ++ncaught; }
+        try { deconv(arr, filt, ws, rows); } catch (const ValueError&) { ++ncaught; }
+        try { rdeconv(arr, hfilt, ws, rows); } catch (const ValueError&) { ++ncaught; }
+        Assert(ncaught == 4);
+    }
+}
+
+void test_speed(int nrows, int ncols)
+{
+    array_xxc spec;
+    dft(array_xxf::Zero(nrows, ncols), spec); // warm up
+    for (double occupancy : {1.0, 0.5, 0.1}) {
+        array_xxf arr = sparse_frame(nrows, ncols, occupancy);
+        double t_dense = 1e9, t_sparse = 1e9;
+        for (int count = 0; count < 3; ++count) {
+            t_dense = std::min(t_dense, Testing::time_ms([&]() { dft(arr, spec); }));
+            t_sparse = std::min(t_sparse, Testing::time_ms([&]() { dft(arr, spec, active_rows(arr)); }));
+        }
+        cerr << "occupancy " << occupancy << " of (" << nrows << "," << ncols << "): "
+             << "dft: " << t_dense << " ms, sparse dft: " << t_sparse << " ms" << endl;
+    }
+}
+
+int main()
+{
+    test_same(100, 300, 0.2);
+    test_same(37, 64, 0.0);
+    test_same(37, 65, 1.0);
+    test_errors();
+    test_speed(800, 6000);
+    return 0;
+}
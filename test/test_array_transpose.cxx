@@ -0,0 +1,43 @@
+// Benchmark the tiled transpose of the row passes against gathering
+// each strided row on its own, for typical detector frame shapes.
+
+#include "WireCellUtil/Array.h"
+#include "WireCellUtil/Testing.h"
+
+#include <iostream>
+
+using namespace std;
+using namespace WireCell;
+using namespace WireCell::Array;
+
+void test_shape(int nrows, int ncols)
+{
+    array_xxf arr = Eigen::ArrayXXf::Random(nrows, ncols);
+    array_xxc spec;
+    array_xxf back;
+
+    set_row_block(0);
+    const array_xxc want = dft(arr);
+    const double t_strided = Testing::time_ms([&]() { dft(arr, spec); idft(spec, back); });
+
+    set_row_block(16);
+    const array_xxc got = dft(arr);
+    const double t_tiled = Testing::time_ms([&]() { dft(arr, spec); idft(spec, back); });
+
+    Assert((got == want).all());
+    Assert((back - arr).abs().maxCoeff() < 1e-4);
+
+    cerr << "frame(" << nrows << "," << ncols << ") dft+idft: "
+         << "strided rows: " << t_strided << " ms, "
+         << "tiled rows: " << t_tiled << " ms, "
+         << "speedup: " << t_strided/t_tiled << endl;
+}
+
+int main()
+{
+    test_shape(33, 17);         // ragged last block
+    test_shape(800, 6000);      // induction plane, 3 ms readout
+    test_shape(960, 6000);      // collection plane, 3 ms readout
+    test_shape(2400, 9600);     // large plane, 4.8 ms readout
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include "WireCellUtil/BinRangeSet.h"
+#include "WireCellUtil/Testing.h"
+
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace WireCell;
+using namespace WireCell::Waveform;
+
+const int nbins = 200;
+typedef std::vector<bool> bitmap_t;
+
+bitmap_t bitmap(const BinRangeList& brl)
+{
+    bitmap_t ret(nbins, false);
+    for (const auto& br : brl) {
+        for (int bin = br.first; bin < br.second; ++bin) {
+            ret[bin] = true;
+        }
+    }
+    return ret;
+}
+
+BinRangeList random_ranges(std::default_random_engine& re, int n)
+{
+    std::uniform_int_distribution<int> start(0, nbins-1), width(0, 20);
+    BinRangeList ret;
+    for (int ind = 0; ind < n; ++ind) {
+        const int beg = start(re);
+        ret.push_back(BinRange(beg, std::min(nbins, beg + width(re))));
+    }
+    return ret;
+}
+
+// Check sorted, disjoint, not touching and nonempty.
+void assert_canonical(const BinRangeList& brl)
+{
+    for (size_t ind = 0; ind < brl.size(); ++ind) {
+        Assert(brl[ind].first < brl[ind].second);
+        if (ind) {
+            Assert(brl[ind-1].second < brl[ind].first);
+        }
+    }
+}
+
+void test_binrangeset()
+{
+    const BinRangeList touching{{0,5},{5,8}}, nested{{0,10},{2,5}}, one{{0,8}}, ten{{0,10}};
+    Assert(BinRangeSet(touching).ranges() == one);
+    Assert(BinRangeSet(nested).ranges() == ten);
+    Assert(BinRangeSet(BinRangeList(1, BinRange(3,3))).empty());
+    Assert(merge(BinRangeList{}).empty());
+
+    std::default_random_engine re(42);
+    for (int trial = 0; trial < 500; ++trial) {
+        const auto la = random_ranges(re, trial % 10), lb = random_ranges(re, trial % 7);
+        const BinRangeSet a(la), b(lb);
+        const auto ba = bitmap(la), bb = bitmap(lb);
+
+        bitmap_t bu(nbins), bi(nbins), bd(nbins);
+        for (int bin = 0; bin < nbins; ++bin) {
+            bu[bin] = ba[bin] || bb[bin];
+            bi[bin] = ba[bin] && bb[bin];
+            bd[bin] = ba[bin] && !bb[bin];
+            Assert(a.contains(bin) == ba[bin]);
+        }
+        Assert(!a.contains(-1) && !a.contains(nbins));
+
+        const auto u = (a|b).ranges(), i = (a&b).ranges(), d = (a-b).ranges();
+        assert_canonical(a.ranges());
+        assert_canonical(u);
+        assert_canonical(i);
+        assert_canonical(d);
+        Assert(bitmap(u) == bu);
+        Assert(bitmap(i) == bi);
+        Assert(bitmap(d) == bd);
+        Assert(merge(la, lb) == u);
+
+        BinRangeSet c(a);
+        for (const auto& br : lb) {
+            c.insert(br.first, br.second);
+        }
+        Assert(c == (a|b));
+    }
+}
+
+ChannelMasks random_masks(std::default_random_engine& re, int nchan, int nper)
+{
+    std::uniform_int_distribution<int> chan(0, 4*nchan);
+    ChannelMasks ret;
+    for (int ind = 0; ind < nchan; ++ind) {
+        ret[chan(re)] = random_ranges(re, nper);
+    }
+    return ret;
+}
+
+void test_channelmaskset()
+{
+    std::default_random_engine re(7);
+    for (int trial = 0; trial < 50; ++trial) {
+        const auto ma = random_masks(re, 30, 5), mb = random_masks(re, 30, 5);
+        const ChannelMaskSet a(ma), b(mb);
+        Assert(ChannelMaskSet(a.masks()) == a);
+
+        const ChannelMaskSet u = a|b, i = a&b, d = a-b;
+        for (int ch = -1; ch <= 121; ++ch) {
+            const auto ra = a.ranges(ch), rb = b.ranges(ch);
+            Assert(u.ranges(ch) == (ra|rb));
+            Assert(i.ranges(ch) == (ra&rb));
+            Assert(d.ranges(ch) == (ra-rb));
+            for (int bin = 0; bin < nbins; bin += 3) {
+                Assert(a.contains(ch, bin) == ra.contains(bin));
+            }
+        }
+        for (size_t ind = 0; ind < i.nchannels(); ++ind) {
+            Assert(!i.at(ind).empty());
+            Assert(i.index(i.channels()[ind]) == (int)ind);
+        }
+        Assert(merge(ma, mb) == u.masks());
+    }
+}
+
+void test_speed()
+{
+    std::default_random_engine re(1);
+    const auto ma = random_masks(re, 8000, 4), mb = random_masks(re, 8000, 4);
+    const int ntimes = 20;
+
+    size_t nmap = 0;
+    const double t_map = Testing::time_ms([&]() {
+        for (int count = 0; count < ntimes; ++count) {
+            nmap += merge(ma, mb).size();
+        }
+    });
+    const ChannelMaskSet a(ma), b(mb);
+    size_t nset = 0;
+    const double t_set = Testing::time_ms([&]() {
+        for (int count = 0; count < ntimes; ++count) {
+            nset += (a|b).nchannels();
+        }
+    });
+    Assert(nmap == nset);
+    cerr << "union of " << ma.size() << " and " << mb.size() << " channels: ChannelMasks "
+         << t_map/ntimes << " ms, ChannelMaskSet " << t_set/ntimes
+         << " ms" << endl;
+}
+
+int main()
+{
+    test_binrangeset();
+    test_channelmaskset();
+    test_speed();
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include "WireCellUtil/ComplexKernels.h"
+#include "WireCellUtil/Testing.h"
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace WireCell;
+using namespace WireCell::ComplexKernels;
+
+typedef std::complex<float> cfloat;
+typedef std::vector<cfloat> cvec;
+
+cvec random_spectrum(size_t n, int seed)
+{
+    std::default_random_engine re(seed);
+    std::normal_distribution<float> dist(0, 10);
+    cvec ret(n);
+    for (auto& c : ret) {
+        c = cfloat(dist(re), dist(re));
+    }
+    return ret;
+}
+
+bool close(cfloat a, cfloat b)
+{
+    return std::abs(a-b) <= 1e-5*std::max(1.0f, std::abs(b));
+}
+
+void test_level(Level lvl)
+{
+    Assert(set_level(lvl) == lvl);
+    cerr << "checking " << level_name(lvl) << endl;
+
+    // odd size exercises the scalar tails
+    const size_t n = 1001;
+    cvec a = random_spectrum(n, 1), b = random_spectrum(n, 2), out(n);
+    b[10] = 0;
+
+    multiply(out.data(), a.data(), b.data(), n);
+    for (size_t ind = 0; ind < n; ++ind) {
+        Assert(close(out[ind], a[ind]*b[ind]));
+    }
+    multiply_conj(out.data(), a.data(), b.data(), n);
+    for (size_t ind = 0; ind < n; ++ind) {
+        Assert(close(out[ind], a[ind]*std::conj(b[ind])));
+    }
+    divide(out.data(), a.data(), b.data(), n);
+    for (size_t ind = 0; ind < n; ++ind) {
+        if (ind == 10) {
+            Assert(out[ind] == cfloat(0));
+            continue;
+        }
+        Assert(close(out[ind], a[ind]/b[ind]));
+    }
+    divide(out.data(), a.data(), b.data(), n, 1e9);
+    for (size_t ind = 0; ind < n; ++ind) {
+        Assert(out[ind] == cfloat(0));
+    }
+
+    // in place
+    cvec c = a;
+    multiply(c.data(), c.data(), b.data(), n);
+    for (size_t ind = 0; ind < n; ++ind) {
+        Assert(close(c[ind], a[ind]*b[ind]));
+    }
+}
+
+void test_double()
+{
+    std::complex<double> a(1,2), b(3,-4), out;
+    multiply(&out, &a, &b, 1);
+    Assert(std::abs(out - a*b) < 1e-12);
+    multiply_conj(&out, &a, &b, 1);
+    Assert(std::abs(out - a*std::conj(b)) < 1e-12);
+    divide(&out, &a, &b, 1);
+    Assert(std::abs(out - a/b) < 1e-12);
+}
+
+void bench()
+{
+    const size_t n = 800*3001;  // a half spectrum frame
+    cvec a = random_spectrum(n, 3), b = random_spectrum(n, 4), out(n);
+
+    double t_std = 1e9;
+    for (int count = 0; count < 5; ++count) {
+        t_std = std::min(t_std, Testing::time_ms([&]() {
+                    for (size_t ind = 0; ind < n; ++ind) {
+                        out[ind] = a[ind] / b[ind];
+                    }
+                }));
+    }
+    cerr << "std::complex divide: " << t_std << " ms" << endl;
+
+    for (int lvl = scalar; lvl <= best_level(); ++lvl) {
+        set_level((Level)lvl);
+        double t_mul = 1e9, t_div = 1e9;
+        for (int count = 0; count < 5; ++count) {
+            t_mul = std::min(t_mul, Testing::time_ms([&]() { multiply(out.data(), a.data(), b.data(), n); }));
+            t_div = std::min(t_div, Testing::time_ms([&]() { divide(out.data(), a.data(), b.data(), n); }));
+        }
+        cerr << level_name((Level)lvl) << ": multiply " << t_mul
+             << " ms, divide " << t_div << " ms" << endl;
+    }
+    set_level(best_level());
+}
+
+int main()
+{
+    cerr << "best level: " << level_name(best_level()) << endl;
+    for (int lvl = scalar; lvl <= best_level(); ++lvl) {
+        test_level((Level)lvl);
+    }
+    test_double();
+    bench();
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include "WireCellUtil/Array.h"
+#include "WireCellUtil/Exceptions.h"
+#include "WireCellUtil/Parallel.h"
+#include "WireCellUtil/Testing.h"
+
+#include <iostream>
+
+using namespace std;
+using namespace WireCell;
+using namespace WireCell::Array;
+
+void test_same(int nrows, int ncols)
+{
+    array_xxc filt = Eigen::ArrayXXcf::Random(nrows, ncols);
+    array_xxc hfilt = filt.leftCols(ncols/2+1);
+    Deconvolver full(filt, nrows, ncols), half(hfilt, nrows, ncols);
+    Assert((full.filter() == half.filter()).all());
+
+    const int nframes = 7;
+    std::vector<array_xxf> frames, want;
+    for (int ind=0; ind<nframes; ++ind) {
+        frames.push_back(Eigen::ArrayXXf::Random(nrows, ncols));
+        want.push_back(rdeconv(frames.back(), hfilt));
+        Assert((want.back() - deconv(frames.back(), filt)).abs().maxCoeff() < 1e-4);
+    }
+
+    array_xxf one = frames[0];
+    full(one);
+    Assert((one == want[0]).all());
+
+    for (int nthreads : {1, 3}) {
+        Parallel::set_nthreads(nthreads);
+        auto batch = frames;
+        half(batch);
+        for (int ind=0; ind<nframes; ++ind) {
+            Assert((batch[ind] == want[ind]).all());
+        }
+    }
+    Parallel::set_nthreads(1);
+}
+
+void test_errors()
+{
+    array_xxc filt = Eigen::ArrayXXcf::Random(10, 20);
+    bool caught = false;
+    try {
+        Deconvolver bad(filt, 10, 30);
+    }
+    catch (const ValueError&) {
+        caught = true;
+    }
+    Assert(caught);
+
+    Deconvolver deco(filt, 10, 20);
+    array_xxf frame = Eigen::ArrayXXf::Random(11, 20);
+    caught = false;
+    try {
+        deco(frame);
+    }
+    catch (const ValueError&) {
+        caught = true;
+    }
+    Assert(caught);
+}
+
+void test_speed(int nrows, int ncols, int nframes)
+{
+    array_xxc filt = Eigen::ArrayXXcf::Random(nrows, ncols);
+    std::vector<array_xxf> frames(nframes, Eigen::ArrayXXf::Random(nrows, ncols));
+    Deconvolver deco(filt, nrows, ncols);
+    deco(frames[0]);            // warm up
+
+    const double t_each = Testing::time_ms([&]() {
+            for (auto& frame : frames) {
+                frame = deconv(frame, filt);
+            }
+        });
+    const double t_batch = Testing::time_ms([&]() { deco(frames); });
+    cerr << nframes << " frames(" << nrows << "," << ncols << ") "
+         << "deconv each: " << t_each << " ms, "
+         << "Deconvolver batch: " << t_batch << " ms, "
+         << "with " << Parallel::nthreads() << " threads" << endl;
+}
+
+int main()
+{
+    test_same(50, 101);
+    test_same(64, 128);
+    test_errors();
+    Parallel::set_nthreads(0);
+    test_speed(800, 6000, 3);
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include "WireCellUtil/FFTBestLength.h"
+#include "WireCellUtil/Exceptions.h"
+#include "WireCellUtil/Testing.h"
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+using namespace WireCell;
+
+void test_smooth()
+{
+    Assert(fft_smooth(1));
+    Assert(fft_smooth(6000));
+    Assert(fft_smooth(2*3*5*7*7));
+    Assert(!fft_smooth(11));
+    Assert(fft_smooth(11, 11));
+    Assert(!fft_smooth(13, 11));
+    Assert(fft_smooth(143, 13));
+    Assert(!fft_smooth(9601, 13));
+    Assert(!fft_smooth(0));
+}
+
+void test_search(int max_prime)
+{
+    fft_best_length_config(max_prime);
+    for (size_t n : {2, 17, 33, 1000, 1021, 6000, 9595, 9601, 16385, 100003, 1000001}) {
+        for (bool keep : {false, true}) {
+            const size_t best = fft_best_length(n, keep);
+            Assert(best >= n);
+            Assert(fft_smooth(best, max_prime));
+            if (keep) {
+                Assert(best % 2 == n % 2);
+            }
+            // nothing smaller qualifies
+            for (size_t m = n; m < best; ++m) {
+                Assert(!fft_smooth(m, max_prime) || (keep && m % 2 != n % 2));
+            }
+            // cached
+            Assert(fft_best_length(n, keep) == best);
+        }
+    }
+    Assert(fft_best_length(6000) == 6000);
+    Assert(fft_best_length(0) == 0);
+    Assert(fft_best_length(1) == 1);
+    fft_best_length_config();
+}
+
+void test_calibrate()
+{
+    fft_best_length_config(7, true);
+    for (size_t n : {1000, 2999, 9601}) {
+        size_t best = 0;
+        const double dt = Testing::time_ms([&]() { best = fft_best_length(n); });
+        const size_t first = fft_best_length(n);
+        Assert(best == first);
+        Assert(best >= n && fft_smooth(best));
+        cerr << "calibrated best length for " << n << " is " << best
+             << ", took " << dt << " ms" << endl;
+    }
+    fft_best_length_config();
+    cerr << "uncalibrated best length for 9601 is " << fft_best_length(9601) << endl;
+}
+
+void test_config()
+{
+    for (int bad : {0, 5, 8, 17}) {
+        bool caught = false;
+        try {
+            fft_best_length_config(bad);
+        }
+        catch (const ValueError&) {
+            caught = true;
+        }
+        Assert(caught);
+    }
+    fft_best_length_config();
+}
+
+// Cache hits are answered while another thread calibrates.
+void test_concurrent()
+{
+    fft_best_length_config(7, true);
+    const size_t known = fft_best_length(1000);
+    std::atomic<bool> done(false);
+    std::thread calib([&]() {
+        fft_best_length(50021);
+        done = true;
+    });
+    int nhits = 0;
+    while (!done) {
+        Assert(fft_best_length(1000) == known);
+        ++nhits;
+    }
+    calib.join();
+    cerr << "cache hits during a calibration: " << nhits << endl;
+    fft_best_length_config();
+}
+
+int main()
+{
+    test_smooth();
+    test_search(7);
+    test_search(11);
+    test_search(13);
+    test_calibrate();
+    test_config();
+    test_concurrent();
+    return 0;
+}
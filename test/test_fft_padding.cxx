@@ -0,0 +1,99 @@
+#include "WireCellUtil/Array.h"
+#include "WireCellUtil/FFTBestLength.h"
+#include "WireCellUtil/Waveform.h"
+#include "WireCellUtil/Exceptions.h"
+#include "WireCellUtil/Testing.h"
+
+#include <iostream>
+
+using namespace std;
+using namespace WireCell;
+
+void test_pad()
+{
+    Waveform::realseq_t wave{1, 2, 3, 4};
+    auto zero = Waveform::pad(wave, 7);
+    Assert(zero == Waveform::realseq_t({1, 2, 3, 4, 0, 0, 0}));
+    auto refl = Waveform::pad(wave, 12, Waveform::pad_reflect);
+    Assert(refl == Waveform::realseq_t({1, 2, 3, 4, 3, 2, 1, 2, 3, 4, 3, 2}));
+    Assert(Waveform::pad(wave, 2) == wave);
+
+    Array::array_xxf arr(2, 4);
+    arr << 1, 2, 3, 4,
+        5, 6, 7, 8;
+    Array::array_xxf arefl = Array::pad(arr, 12, Waveform::pad_reflect);
+    for (int ind=0; ind<12; ++ind) {
+        Assert(arefl(0,ind) == refl[ind]);
+        Assert(arefl(1,ind) == refl[ind]+4);
+    }
+}
+
+void test_waveform(int nsamples)
+{
+    Waveform::realseq_t wave(nsamples);
+    for (int ind=0; ind<nsamples; ++ind) {
+        wave[ind] = sin(0.01*ind*ind);
+    }
+    for (auto type : {Waveform::pad_zero, Waveform::pad_reflect}) {
+        int npad = -1;
+        auto spec = Waveform::dft_padded(wave, npad, type);
+        Assert(npad >= 0);
+        Assert((int)spec.size() == nsamples + npad);
+        Assert((int)fft_best_length(nsamples) == nsamples + npad);
+        auto back = Waveform::idft_cropped(spec, npad);
+        Assert((int)back.size() == nsamples);
+        for (int ind=0; ind<nsamples; ++ind) {
+            Assert(std::abs(back[ind]-wave[ind]) < 1e-4);
+        }
+    }
+}
+
+void test_array(int nrows, int ncols)
+{
+    Array::array_xxf arr = Eigen::ArrayXXf::Random(nrows, ncols);
+    int npad = -1;
+    auto spec = Array::dft_padded(arr, npad, Waveform::pad_reflect);
+    Assert(spec.cols() == ncols + npad);
+    Assert(spec.cols() == Array::padded_cols(ncols));
+    auto back = Array::idft_cropped(spec, npad);
+    Assert(back.cols() == ncols);
+    Assert((back - arr).abs().maxCoeff() < 1e-4);
+
+    // unit filter leaves the frame unchanged
+    Array::array_xxc filt = Eigen::ArrayXXcf::Ones(nrows, Array::padded_cols(ncols));
+    auto deco = Array::deconv_padded(arr, filt);
+    Assert(deco.cols() == ncols);
+    Assert((deco - arr).abs().maxCoeff() < 1e-4);
+
+    Array::array_xxc full = Eigen::ArrayXXcf::Ones(nrows, ncols);
+    const double t_plain = Testing::time_ms([&]() { Array::deconv(arr, full); });
+    const double t_padded = Testing::time_ms([&]() { Array::deconv_padded(arr, filt); });
+    cerr << "deconv(" << nrows << "," << ncols << "): " << t_plain << " ms, "
+         << "padded to " << ncols+npad << " columns: " << t_padded << " ms" << endl;
+}
+
+void test_crop_range()
+{
+    const Waveform::compseq_t spec(8, 1.0);
+    const Array::array_xxc arr = Eigen::ArrayXXcf::Ones(3, 8);
+    Assert(Waveform::idft_cropped(spec, 8).empty());
+    Assert(Array::idft_cropped(arr, 8).cols() == 0);
+    int ncaught = 0;
+    for (int npad : {-1, 9}) {
+        try { Waveform::idft_cropped(spec, npad); } catch (const ValueError&) { ++ncaught; }
+        try { Array::idft_cropped(arr, npad); } catch (const ValueError&) { ++ncaught; }
+    }
+    Assert(ncaught == 4);
+}
+
+int main()
+{
+    test_pad();
+    test_crop_range();
+    test_waveform(1);
+    test_waveform(1021);
+    test_waveform(4096);
+    test_array(16, 1);
+    test_array(100, 1999);      // prime
+    return 0;
+}
@@ -0,0 +1,167 @@
+// Compare Array transforms going through the FFT plan cache with the
+// original per-call Eigen::FFT implementation.
+
+#include "WireCellUtil/Array.h"
+#include "WireCellUtil/Waveform.h"
+#include "WireCellUtil/FFTBestLength.h"
+#include "WireCellUtil/FFTPlanCache.h"
+#include "WireCellUtil/Testing.h"
+
+#include <unsupported/Eigen/FFT>
+
+#include <iostream>
+#include <thread>
+
+using namespace std;
+using namespace WireCell;
+using namespace WireCell::Array;
+
+// The original implementation: a fresh engine and row temporaries on
+// every call.
+array_xxc dft_fresh(const array_xxf& arr)
+{
+    const int nrows = arr.rows();
+    const int ncols = arr.cols();
+
+    Eigen::FFT< float > fft;
+    Eigen::MatrixXcf matc(nrows, ncols);
+
+    for (int irow = 0; irow < nrows; ++irow) {
+        Eigen::VectorXcf fspec(ncols);
+	Eigen::VectorXf tmp = arr.row(irow);
+	fft.fwd(fspec, tmp);
+        matc.row(irow) = fspec;
+    }
+    for (int icol = 0; icol < ncols; ++icol) {
+        Eigen::VectorXcf pspec(nrows);
+        fft.fwd(pspec, matc.col(icol));
+        matc.col(icol) = pspec;
+    }
+    return matc;
+}
+
+double relative_difference(const array_xxc& a, const array_xxc& b)
+{
+    return (a-b).matrix().norm() / b.matrix().norm();
+}
+
+void test_same(int nrows, int ncols)
+{
+    array_xxf arr = Eigen::ArrayXXf::Random(nrows, ncols);
+    auto spec1 = dft(arr);
+    auto spec2 = dft_fresh(arr);
+    const double diff = relative_difference(spec1, spec2);
+    cerr << "dft(" << nrows << "," << ncols << ") relative difference: " << diff << endl;
+    Assert(diff < 1e-6);
+
+    // a repeat pass must not make new plans
+    auto arr2 = idft(dft(arr));
+    const size_t nplans = FFTPlanCache::nplans();
+    auto arr3 = idft(dft(arr));
+    Assert(FFTPlanCache::nplans() == nplans);
+    Assert((arr2-arr3).abs().maxCoeff() == 0.0);
+    Assert((arr-arr2).abs().maxCoeff() < 1e-4);
+}
+
+// Real and complex transforms of the same length must not share a
+// plan, eg the rows and columns of a square frame or a waveform as
+// long as the columns of a frame.
+void test_mixed(int n)
+{
+    array_xxf square = Eigen::ArrayXXf::Random(n, n);
+    Assert(relative_difference(dft(square), dft_fresh(square)) < 1e-6);
+    Assert((idft(dft(square)) - square).abs().maxCoeff() < 1e-4);
+
+    Waveform::realseq_t wave(n);
+    for (int ind = 0; ind < n; ++ind) {
+	wave[ind] = square(ind, 0);
+    }
+    array_xxf tall = Eigen::ArrayXXf::Random(n, 7);
+    const auto wspec = Waveform::dft(wave);
+    const auto tspec = dft(tall);
+    const auto wback = Waveform::idft(wspec);
+    Assert(relative_difference(tspec, dft_fresh(tall)) < 1e-6);
+
+    Eigen::FFT<float> fft;
+    Eigen::VectorXf vwave = square.col(0);
+    Eigen::VectorXcf vspec(n);
+    fft.fwd(vspec, vwave);
+    for (int ind = 0; ind < n; ++ind) {
+	Assert(std::abs(wspec[ind] - vspec[ind]) < 1e-3);
+	Assert(std::abs(wback[ind] - wave[ind]) < 1e-4);
+    }
+
+    auto& cache = FFTPlanCache::local();
+    Eigen::VectorXcf cin = Eigen::VectorXcf::Random(n), cout(n), cwant(n);
+    cache.fwd(cout, vwave);
+    cache.fwd(cout, cin);
+    fft.fwd(cwant, cin);
+    Assert((cout - cwant).norm() < 1e-4*cwant.norm());
+    cache.inv(cout, cin);
+    fft.inv(cwant, cin);
+    Assert((cout - cwant).norm() < 1e-4*cwant.norm());
+}
+
+void test_threads(int nrows, int ncols)
+{
+    array_xxf arr = Eigen::ArrayXXf::Random(nrows, ncols);
+    const auto want = dft(arr);
+
+    const int nthreads = 4;
+    std::vector<array_xxc> got(nthreads);
+    std::vector<std::thread> threads;
+    for (int ith=0; ith<nthreads; ++ith) {
+	threads.emplace_back([&,ith]() { got[ith] = dft(arr); });
+    }
+    for (auto& th : threads) {
+	th.join();
+    }
+    for (const auto& one : got) {
+	Assert((one-want).abs().maxCoeff() == 0.0);
+    }
+}
+
+// The cache saves planning, the row temporaries and, through tiling,
+// strided access.  It can not speed up the butterflies themselves so
+// for lengths with large prime factors, eg 9595 = 5*19*101, which
+// kissfft does in O(n*p), both take the same time to within noise.
+// Those lengths are better padded, see fft_best_length().
+void test_speed(int nrows, int ncols, int nframes)
+{
+    array_xxf arr = Eigen::ArrayXXf::Random(nrows, ncols);
+    array_xxc filt = Eigen::ArrayXXcf::Zero(nrows, ncols) + 1.0;
+
+    dft(arr);                   // steady state: plans already made
+    const double t_fresh = Testing::best_time_ms([&]() { dft_fresh(arr); }, nframes);
+    const double t_cache = Testing::best_time_ms([&]() { dft(arr); }, nframes);
+    const double t_deconv = Testing::best_time_ms([&]() { deconv(arr, filt); }, nframes);
+    cerr << "frame(" << nrows << "," << ncols << "): "
+	 << "dft fresh: " << t_fresh << " ms, "
+	 << "dft cached: " << t_cache << " ms, "
+	 << "speedup: " << t_fresh/t_cache << ", "
+	 << "deconv: " << t_deconv << " ms";
+    if (!fft_smooth(ncols)) {
+	cerr << " (length " << ncols << " is not 7-smooth, butterflies dominate)";
+    }
+    cerr << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    test_same(300, 1000);
+    test_same(17, 31);
+    test_mixed(64);
+    test_mixed(100);
+    test_threads(100, 600);
+
+    int nframes = 2;
+    if (argc > 1) {
+	nframes = atoi(argv[1]);
+    }
+    test_speed(800, 6000, nframes);
+    test_speed(480, 9595, nframes);
+    test_speed(2400, 1000, nframes);
+
+    cerr << "plans created: " << FFTPlanCache::nplans() << endl;
+    return 0;
+}
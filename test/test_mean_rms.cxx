@@ -0,0 +1,105 @@
+#include "WireCellUtil/Waveform.h"
+#include "WireCellUtil/Array.h"
+#include "WireCellUtil/Testing.h"
+
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace WireCell;
+
+// Two pass reference in double.
+std::pair<double,double> reference(const Waveform::realseq_t& wf)
+{
+    double mean = 0;
+    for (auto v : wf) { mean += v; }
+    mean /= wf.size();
+    double var = 0;
+    for (auto v : wf) { var += (v-mean)*(v-mean); }
+    return std::make_pair(mean, std::sqrt(var/wf.size()));
+}
+
+// The original, copying to double and summing in two passes.
+std::pair<double,double> copying(const Waveform::realseq_t& wf)
+{
+    const int n = wf.size();
+    std::vector<double> wfd(wf.begin(), wf.end());
+    const double wsum = Waveform::sum(wfd);
+    const double w2sum = Waveform::sum2(wfd);
+    return std::make_pair(wsum/n, sqrt((w2sum - wsum*wsum/n) / n));
+}
+
+Array::array_xxf adc_like(int nrows, int ncols)
+{
+    std::default_random_engine re(1);
+    std::normal_distribution<float> noise(0, 2.5);
+    Array::array_xxf arr(nrows, ncols);
+    for (int irow = 0; irow < nrows; ++irow) {
+        const float ped = 400 + 10*irow;
+        for (int icol = 0; icol < ncols; ++icol) {
+            arr(irow, icol) = ped + noise(re);
+        }
+    }
+    return arr;
+}
+
+void test_values()
+{
+    const Array::array_xxf arr = adc_like(300, 6001);
+    Array::array_xd mean, rms;
+    Array::mean_rms(arr, mean, rms);
+    Assert(mean.size() == 300 && rms.size() == 300);
+
+    for (int irow = 0; irow < arr.rows(); irow += 7) {
+        Waveform::realseq_t wf(arr.cols());
+        for (int icol = 0; icol < arr.cols(); ++icol) {
+            wf[icol] = arr(irow, icol);
+        }
+        const auto want = reference(wf);
+        const auto got = Waveform::mean_rms(wf);
+        Assert(std::abs(got.first - want.first) < 1e-9);
+        Assert(std::abs(got.second - want.second) < 1e-9);
+        const auto row = Waveform::mean_rms(arr.row(irow));
+        Assert(std::abs(row.first - want.first) < 1e-9);
+        Assert(std::abs(row.second - want.second) < 1e-9);
+        Assert(std::abs(mean[irow] - want.first) < 1e-9);
+        Assert(std::abs(rms[irow] - want.second) < 1e-9);
+    }
+
+    // degenerate
+    Assert(Waveform::mean_rms(Waveform::realseq_t{}) == std::make_pair(0.0, 0.0));
+    Assert(Waveform::mean_rms(Waveform::realseq_t{3}) == std::make_pair(3.0, 0.0));
+    const auto flat = Waveform::mean_rms(Waveform::realseq_t(100, 1e6));
+    Assert(flat.first == 1e6 && flat.second == 0);
+}
+
+void test_speed()
+{
+    const Array::array_xxf arr = adc_like(2400, 6000);
+    std::vector<Waveform::realseq_t> waves(arr.rows());
+    for (int irow = 0; irow < arr.rows(); ++irow) {
+        waves[irow].resize(arr.cols());
+        for (int icol = 0; icol < arr.cols(); ++icol) {
+            waves[irow][icol] = arr(irow, icol);
+        }
+    }
+    double sum1 = 0, sum2 = 0;
+    const double t_copy = Testing::time_ms([&]() {
+            for (const auto& wf : waves) { sum1 += copying(wf).second; }
+        });
+    const double t_one = Testing::time_ms([&]() {
+            for (const auto& wf : waves) { sum2 += Waveform::mean_rms(wf).second; }
+        });
+    Array::array_xd mean, rms;
+    const double t_frame = Testing::time_ms([&]() { Array::mean_rms(arr, mean, rms); });
+    Assert(std::abs(sum1 - sum2) < 1e-6*sum1);
+    cerr << "mean_rms of " << arr.rows() << " channels: copying " << t_copy
+         << " ms, single pass " << t_one << " ms, whole frame " << t_frame << " ms" << endl;
+}
+
+int main()
+{
+    test_values();
+    test_speed();
+    return 0;
+}
@@ -1,24 +1,110 @@
 #include "WireCellUtil/Waveform.h"
+#include "WireCellUtil/Array.h"
+#include "WireCellUtil/Testing.h"
+
 #include <iostream>
+#include <random>
 
-using namespace WireCell;
 using namespace std;
+using namespace WireCell;
 
-int main()
+// The original, full histogram implementation.
+short full_scan(const std::vector<short>& vals)
+{
+    const size_t nbins = 1<<16;
+    std::vector<unsigned int> hist(nbins, 0);
+    for (unsigned short val : vals) {
+        hist[val] += 1;
+    }
+    auto it = std::max_element(hist.begin(), hist.end());
+    return it - hist.begin();
+}
+
+Array::array_xxs adc_frame(int nrows, int ncols, float sigma)
+{
+    std::default_random_engine re(nrows);
+    std::normal_distribution<float> noise(0, sigma);
+    Array::array_xxs adc(nrows, ncols);
+    for (int irow = 0; irow < nrows; ++irow) {
+        const int ped = (irow % 3 == 0) ? 0 : 400 + irow; // some around zero
+        for (int icol = 0; icol < ncols; ++icol) {
+            adc(irow, icol) = ped + std::round(noise(re));
+        }
+    }
+    return adc;
+}
+
+std::vector<short> row_of(const Array::array_xxs& adc, int irow)
+{
+    std::vector<short> ret(adc.cols());
+    for (int icol = 0; icol < adc.cols(); ++icol) {
+        ret[icol] = adc(irow, icol);
+    }
+    return ret;
+}
+
+void test_known()
 {
     {
 	std::vector<short> adcv{-1,0,0,1,1,2,3,4,4,4,5,6,4,3,4,5,6,7,7,6,5};
 	auto mf = Waveform::most_frequent(adcv);
 	cerr << mf << endl;
+	Assert(mf == 4);
     }
     {
 	std::vector<short> adcv{-1,0,0,-1,-1,2,3,4,4,-1,-1,5,6,4,3,4,5,6,7,7,6,5};
 	auto mf = Waveform::most_frequent(adcv);
 	cerr << mf << endl;
+	Assert(mf == -1);
     }
     {
 	std::vector<short> adcv{5,5,5,5,1,1,1,2,2,2,2};
 	auto mf = Waveform::most_frequent(adcv);
 	cerr << mf << endl;
+	Assert(mf == 2);
+    }
+}
+
+void test_same()
+{
+    // few samples so ties are common, including across zero
+    for (float sigma : {1.0f, 3.0f, 100.0f}) {
+        const Array::array_xxs adc = adc_frame(60, 7, sigma);
+        const auto got = Array::most_frequent(adc);
+        for (int irow = 0; irow < adc.rows(); ++irow) {
+            const auto vals = row_of(adc, irow);
+            Assert(Waveform::most_frequent(vals) == full_scan(vals));
+            Assert(got[irow] == full_scan(vals));
+        }
+    }
+    Assert(Waveform::most_frequent(std::vector<short>{-1, 1}) == 1);
+    Assert(Waveform::most_frequent(std::vector<short>{-32768, 32767}) == 32767);
+    Assert(Waveform::most_frequent(std::vector<short>{}) == 0);
+}
+
+void test_speed()
+{
+    const Array::array_xxs adc = adc_frame(2400, 6000, 3);
+    std::vector<std::vector<short> > rows;
+    for (int irow = 0; irow < adc.rows(); ++irow) {
+        rows.push_back(row_of(adc, irow));
     }
+    std::vector<short> a(adc.rows()), b;
+    const double t_full = Testing::time_ms([&]() {
+            for (size_t irow = 0; irow < rows.size(); ++irow) {
+                a[irow] = full_scan(rows[irow]);
+            }
+        });
+    const double t_batch = Testing::time_ms([&]() { b = Array::most_frequent(adc); });
+    Assert(a == b);
+    cerr << "most_frequent of " << adc.rows() << " channels: full histograms "
+         << t_full << " ms, batched " << t_batch << " ms" << endl;
+}
+
+int main()
+{
+    test_known();
+    test_same();
+    test_speed();
+    return 0;
 }
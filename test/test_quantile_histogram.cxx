@@ -0,0 +1,104 @@
+#include "WireCellUtil/Waveform.h"
+#include "WireCellUtil/Testing.h"
+
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace WireCell;
+using namespace WireCell::Waveform;
+
+realseq_t random_wave(size_t n, int seed)
+{
+    std::default_random_engine re(seed);
+    std::normal_distribution<float> dist(0, 10);
+    realseq_t ret(n);
+    for (auto& v : ret) {
+        v = dist(re);
+    }
+    return ret;
+}
+
+// The original percentile_binned().
+real_t old_binned(const realseq_t& wave, real_t percentage)
+{
+    const auto mm = std::minmax_element(wave.begin(), wave.end());
+    const auto vmin = *mm.first;
+    const auto vmax = *mm.second;
+    const int nbins = wave.size();
+    const auto binsize = (vmax-vmin)/nbins;
+    realseq_t hist(nbins);
+    for (auto val : wave) {
+        int bin = int(round((val - vmin)/binsize));
+        bin = std::max(0, bin);
+        bin = std::min(nbins-1, bin);
+        hist[bin] += 1.0;
+    }
+    const int imed = wave.size() * percentage;
+    int count = 0;
+    for (int ind=0; ind<nbins; ++ind) {
+        count += hist[ind];
+        if (count > imed) {
+            return vmin + ind*binsize;
+        }
+    }
+    return vmin + (vmax-vmin)*percentage;
+}
+
+void test_accuracy()
+{
+    const std::vector<real_t> pcts = {0.01, 0.1, 0.5, 0.9, 0.99};
+    for (size_t n : {2, 11, 1000, 6000}) {
+        realseq_t wave = random_wave(n, n);
+        for (size_t nbins : {0, 10, 100}) {
+            QuantileHistogram qh(nbins);
+            qh.fill(wave);
+            const auto binned = qh.quantiles(pcts);
+            const auto exact = qh.quantiles(pcts, true);
+            for (size_t iq = 0; iq < pcts.size(); ++iq) {
+                const real_t want = percentile(wave, pcts[iq]);
+                Assert(exact[iq] == want);
+                Assert(std::abs(binned[iq] - want) <= qh.binsize()*1.0001);
+            }
+        }
+        for (real_t pct : pcts) {
+            Assert(percentile_binned(wave, pct) == old_binned(wave, pct));
+        }
+    }
+
+    realseq_t flat(10, 3.0);
+    QuantileHistogram qh;
+    qh.fill(flat);
+    Assert(qh.quantile(0.5) == 3.0);
+    Assert(qh.quantile(0.5, true) == 3.0);
+}
+
+void test_speed()
+{
+    const realseq_t wave = random_wave(6000, 1);
+    realseq_t scratch = wave;
+    const int ntries = 1000;
+    real_t sum1 = 0, sum2 = 0;
+    const double t_old = Testing::time_ms([&]() {
+            for (int count = 0; count < ntries; ++count) {
+                sum1 += old_binned(wave, 0.1) + old_binned(wave, 0.5) + old_binned(wave, 0.9);
+            }
+        });
+    QuantileHistogram qh;
+    const double t_new = Testing::time_ms([&]() {
+            for (int count = 0; count < ntries; ++count) {
+                qh.fill(wave);
+                sum2 += qh.quantile(0.1) + qh.quantile(0.5) + qh.quantile(0.9);
+            }
+        });
+    Assert(sum1 == sum2);
+    cerr << "10/50/90% of " << ntries << " waves: percentile_binned x3 " << t_old
+         << " ms, QuantileHistogram " << t_new << " ms" << endl;
+}
+
+int main()
+{
+    test_accuracy();
+    test_speed();
+    return 0;
+}
@@ -0,0 +1,200 @@
+#include "WireCellUtil/Waveform.h"
+#include "WireCellUtil/Array.h"
+#include "WireCellUtil/Exceptions.h"
+#include "WireCellUtil/Testing.h"
+
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+using namespace WireCell;
+using namespace WireCell::Waveform;
+
+Waveform::realseq_t sampled(std::function<double(double)> func, const Domain& domain, int n)
+{
+    const double step = sample_width(domain, n);
+    realseq_t ret(n);
+    for (int ind = 0; ind < n; ++ind) {
+        ret[ind] = func(domain.first + ind*step);
+    }
+    return ret;
+}
+
+// RMS difference between a and b over samples [beg, end).
+double rms_diff(const realseq_t& a, const realseq_t& b, int beg, int end)
+{
+    double sum = 0;
+    for (int ind = beg; ind < end; ++ind) {
+        sum += (a[ind]-b[ind])*(a[ind]-b[ind]);
+    }
+    return std::sqrt(sum/(end-beg));
+}
+
+// Straight line interpolation between the two nearest samples.
+realseq_t linear_reference(const realseq_t& wave, const Domain& domain, int nsamples, const Domain& newdomain)
+{
+    const int oldnsamples = wave.size();
+    const double oldstep = sample_width(domain, oldnsamples);
+    const double step = sample_width(newdomain, nsamples);
+    realseq_t ret(nsamples);
+    for (int ind = 0; ind < nsamples; ++ind) {
+        const double oldfracsteps = (newdomain.first + ind*step - domain.first)/oldstep;
+        const int oldind = std::floor(oldfracsteps);
+        if (oldfracsteps <= 0) {
+            ret[ind] = wave[0];
+        }
+        else if (oldind+1 >= oldnsamples) {
+            ret[ind] = wave[oldnsamples-1];
+        }
+        else {
+            const double frac = oldfracsteps - oldind;
+            ret[ind] = wave[oldind]*(1-frac) + wave[oldind+1]*frac;
+        }
+    }
+    return ret;
+}
+
+// resample() keeps its original weights, Resampler interpolates.
+void test_legacy()
+{
+    const realseq_t wave{0, 1, 2, 3};
+    const Domain dom(0, 4);
+    const realseq_t old{0, 0, 2, 1.5, 3, 2.5, 3, 3};
+    const realseq_t lin{0, 0.5, 1, 1.5, 2, 2.5, 3, 3};
+    Assert(resample(wave, dom, 8, dom) == old);
+    Assert(Resampler(dom, 4, dom, 8)(wave) == lin);
+}
+
+void test_linear()
+{
+    const Domain dom(0, 100), newdom(-10, 110);
+    auto wave = sampled([](double t) { return std::sin(0.1*t) + 0.01*t*t; }, dom, 100);
+    for (int newn : {37, 120, 500}) {
+        Resampler rs(dom, 100, newdom, newn);
+        Assert(rs.size() == (size_t)newn);
+        const auto got = rs(wave);
+        const auto want = linear_reference(wave, dom, newn, newdom);
+        Assert(rms_diff(got, want, 0, newn) < 1e-4);
+    }
+    // exact on a line inside the domain
+    auto line = sampled([](double t) { return 3*t - 7; }, dom, 100);
+    const Domain inside(0, 99);
+    auto got = Resampler(dom, 100, inside, 297)(line);
+    auto want = sampled([](double t) { return 3*t - 7; }, inside, 297);
+    Assert(rms_diff(got, want, 0, 297) < 1e-3);
+}
+
+void test_cubic()
+{
+    const Domain dom(0, 50), inside(1, 48);
+    auto quad = [](double t) { return 0.5*t*t - 4*t + 2; };
+    auto got = Resampler(dom, 50, inside, 301, Resampler::cubic)(sampled(quad, dom, 50));
+    auto want = sampled(quad, inside, 301);
+    Assert(rms_diff(got, want, 0, 301) < 1e-3);
+}
+
+void test_bandlimited()
+{
+    // Downsample by 4.  Above the new Nyquist is suppressed while
+    // linear interpolation aliases it.
+    const int n = 4000, newn = 1000;
+    const Domain dom(0, n);
+    Resampler bl(dom, n, dom, newn, Resampler::bandlimited), li(dom, n, dom, newn);
+    const realseq_t zero(newn, 0);
+    auto high = sampled([](double t) { return std::sin(2*M_PI*0.2*t); }, dom, n);
+    const double rms_bl = rms_diff(bl(high), zero, 100, newn-100);
+    const double rms_li = rms_diff(li(high), zero, 100, newn-100);
+    cerr << "alias rms: bandlimited " << rms_bl << ", linear " << rms_li << endl;
+    Assert(rms_bl < 0.01);
+    Assert(rms_li > 0.3);
+
+    // In band passes.
+    auto low = [](double t) { return std::sin(2*M_PI*0.02*t); };
+    auto got = bl(sampled(low, dom, n));
+    Assert(rms_diff(got, sampled(low, dom, newn), 100, newn-100) < 0.01);
+
+    // Upsampling interpolates
+    const Domain inside(0, n/4 - 1);
+    Resampler up(Domain(0, n/4), n/4, inside, n, Resampler::bandlimited);
+    got = up(sampled(low, Domain(0, n/4), n/4));
+    Assert(rms_diff(got, sampled(low, inside, n), 100, n-100) < 1e-3);
+
+    // Constants are kept, including at the ends.
+    auto flat = bl(realseq_t(n, 2.5));
+    Assert(rms_diff(flat, realseq_t(newn, 2.5), 0, newn) < 1e-5);
+}
+
+void test_speed()
+{
+    const int nrows = 2400, nin = 6000, nout = 1500;
+    const Domain dom(0, nin);
+    Array::array_xxf frame = Array::array_xxf::Random(nrows, nin), out(nrows, nout);
+    std::vector<realseq_t> rows(nrows);
+    for (int irow = 0; irow < nrows; ++irow) {
+        rows[irow].resize(nin);
+        for (int icol = 0; icol < nin; ++icol) {
+            rows[irow][icol] = frame(irow, icol);
+        }
+    }
+
+    double sink = 0;
+    const double t_resample = Testing::time_ms([&]() {
+        for (const auto& row : rows) {
+            sink += resample(row, dom, nout, dom)[nout/2];
+        }
+    });
+    Resampler li(dom, nin, dom, nout);
+    realseq_t res(nout);
+    const double t_linear = Testing::time_ms([&]() {
+        for (const auto& row : rows) {
+            li(row, res);
+        }
+    });
+    Resampler bl(dom, nin, dom, nout, Resampler::bandlimited);
+    const double t_bandlimited = Testing::time_ms([&]() {
+        for (const auto& row : rows) {
+            bl(row, res);
+        }
+    });
+    const double t_linear_rows = Testing::time_ms([&]() { li.rows(frame, out); });
+
+    cerr << "resample " << nrows << " rows: resample() " << t_resample
+         << " ms, Resampler linear " << t_linear
+         << " ms, bandlimited (" << bl.ntaps() << " taps) " << t_bandlimited
+         << " ms, linear on array rows " << t_linear_rows << " ms" << endl;
+
+    // column sweeps match row by row
+    Array::array_xxf bout = Array::array_xxf::Zero(nrows, nout);
+    const double t_bandlimited_rows = Testing::time_ms([&]() { bl.rows(frame, bout); });
+    cerr << "bandlimited on array rows " << t_bandlimited_rows << " ms" << endl;
+    for (int irow = 0; irow < nrows; irow += 97) {
+        li(rows[irow], res);
+        for (int icol = 0; icol < nout; ++icol) {
+            Assert(out(irow, icol) == res[icol]);
+        }
+        bl(rows[irow], res);
+        for (int icol = 0; icol < nout; ++icol) {
+            Assert(std::abs(bout(irow, icol) - res[icol]) < 1e-5);
+        }
+    }
+    bool caught = false;
+    try {
+        Array::array_xxf wrong(nrows, nout+1);
+        li.rows(frame, wrong);
+    }
+    catch (const ValueError&) {
+        caught = true;
+    }
+    Assert(caught);
+    Assert(std::isfinite(sink));
+}
+
+int main()
+{
+    test_legacy();
+    test_linear();
+    test_cubic();
+    test_bandlimited();
+    test_speed();
+    return 0;
+}
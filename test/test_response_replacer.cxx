@@ -0,0 +1,137 @@
+#include "WireCellUtil/Waveform.h"
+#include "WireCellUtil/Array.h"
+#include "WireCellUtil/Testing.h"
+
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace WireCell;
+using namespace WireCell::Waveform;
+
+realseq_t random_wave(size_t n, int seed)
+{
+    std::default_random_engine re(seed);
+    std::normal_distribution<float> dist(0, 1);
+    realseq_t ret(n);
+    for (auto& v : ret) {
+        v = dist(re);
+    }
+    return ret;
+}
+
+// A response whose spectrum has no zeros.
+realseq_t response(size_t n, float decay)
+{
+    realseq_t ret(n);
+    for (size_t ind = 0; ind < n; ++ind) {
+        ret[ind] = std::pow(decay, ind);
+    }
+    return ret;
+}
+
+double maxdiff(Span<const real_t> a, Span<const real_t> b)
+{
+    Assert(a.size() == b.size());
+    double ret = 0;
+    for (size_t ind = 0; ind < a.size(); ++ind) {
+        ret = std::max(ret, (double)std::abs(a[ind]-b[ind]));
+    }
+    return ret;
+}
+
+void test_replace()
+{
+    const realseq_t oldres = response(20, 0.5), newres = response(11, -0.3);
+    const realseq_t sig = random_wave(300, 1);
+
+    // a signal seen through the old response, see through the new
+    const realseq_t wave = linear_convolve(sig, oldres, false);
+    const realseq_t want = linear_convolve(sig, newres, false);
+
+    ResponseReplacer rr(newres, oldres, wave.size());
+    const realseq_t got = rr(wave);
+    Assert(got.size() == wave.size());
+    Assert(maxdiff(Span<const real_t>(got.data(), want.size()), want) < 1e-4);
+
+    // same as replace_convolve where the transform lengths agree
+    const realseq_t wave2 = random_wave(981, 2);
+    ResponseReplacer rr2(newres, oldres, wave2.size());
+    Assert(rr2.fft_size() == 1000);
+    Assert(maxdiff(rr2(wave2), replace_convolve(wave2, newres, oldres)) < 1e-3);
+
+    // 2D batch
+    Array::array_xxf frame(5, wave.size());
+    for (int irow = 0; irow < 5; ++irow) {
+        const realseq_t row = linear_convolve(random_wave(300, irow), oldres, false);
+        for (size_t icol = 0; icol < row.size(); ++icol) {
+            frame(irow, icol) = row[icol];
+        }
+    }
+    Array::array_xxf orig = frame;
+    rr.rows(frame);
+    realseq_t row(wave.size());
+    for (int irow = 0; irow < 5; ++irow) {
+        for (size_t icol = 0; icol < row.size(); ++icol) {
+            row[icol] = orig(irow, icol);
+        }
+        Assert(maxdiff(frame.row(irow), rr(row)) == 0);
+    }
+}
+
+void test_regularization()
+{
+    // an old response with a spectral zero at Nyquist
+    const realseq_t oldres = {1, 1}, newres = {1};
+    const realseq_t wave = random_wave(100, 3);
+
+    ResponseReplacer plain(newres, oldres, wave.size());
+    ResponseReplacer reg(newres, oldres, wave.size(), 0.01);
+    const realseq_t a = plain(wave), b = reg(wave);
+    double suma = 0, sumb = 0;
+    for (size_t ind = 0; ind < wave.size(); ++ind) {
+        Assert(std::isfinite(a[ind]) && std::isfinite(b[ind]));
+        suma += a[ind]*a[ind];
+        sumb += b[ind]*b[ind];
+    }
+    cerr << "power, plain: " << suma << " regularized: " << sumb << endl;
+    Assert(sumb < suma);
+
+    // nothing to divide by at all
+    const realseq_t zeros(5, 0);
+    for (real_t r : {0.0f, 0.01f}) {
+        ResponseReplacer none(newres, zeros, wave.size(), r);
+        for (auto val : none(wave)) {
+            Assert(val == 0);
+        }
+    }
+}
+
+void test_speed()
+{
+    // replace_convolve() transforms at 6000, a fast length
+    const int nchan = 1000, ntick = 5801;
+    const realseq_t oldres = response(200, 0.9), newres = response(200, 0.8);
+    std::vector<realseq_t> waves, outs(nchan, realseq_t(ntick));
+    for (int ichan = 0; ichan < nchan; ++ichan) {
+        waves.push_back(random_wave(ntick, ichan));
+    }
+    ResponseReplacer rr(newres, oldres, ntick);
+
+    double t_call = Testing::time_ms([&]() {
+            for (int ichan = 0; ichan < nchan; ++ichan) {
+                replace_convolve(waves[ichan], newres, oldres, outs[ichan]);
+            }
+        });
+    double t_rr = Testing::time_ms([&]() { rr(waves, outs); });
+    cerr << "replace " << nchan << " channels: replace_convolve " << t_call
+         << " ms, ResponseReplacer " << t_rr << " ms" << endl;
+}
+
+int main()
+{
+    test_replace();
+    test_regularization();
+    test_speed();
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "WireCellUtil/Waveform.h"
+#include "WireCellUtil/Array.h"
+#include "WireCellUtil/Testing.h"
+
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace WireCell;
+using namespace WireCell::Waveform;
+
+realseq_t random_wave(size_t n, int seed)
+{
+    std::default_random_engine re(seed);
+    std::normal_distribution<float> dist(0, 10);
+    realseq_t ret(n);
+    for (size_t ind = 0; ind < n; ++ind) {
+        ret[ind] = std::round(dist(re)) + 0.01*ind; // ties and a slope
+    }
+    return ret;
+}
+
+// The straightforward way: percentile of copied sub-vectors.
+realseq_t brute(const realseq_t& wave, size_t window, size_t stride, real_t pct)
+{
+    realseq_t ret;
+    const long n = wave.size(), half = window/2;
+    for (long center = 0; center < n; center += stride) {
+        const long beg = std::max(0L, center - half);
+        const long end = std::min(n, center - half + (long)window);
+        ret.push_back(percentile(realseq_t(wave.begin()+beg, wave.begin()+end), pct));
+    }
+    return ret;
+}
+
+void test_same()
+{
+    const realseq_t wave = random_wave(500, 1);
+    for (size_t window : {1, 2, 7, 64, 1000}) {
+        for (size_t stride : {1, 3, 32, 200}) {
+            for (real_t pct : {0.5f, 0.1f, 0.9f}) {
+                RollingQuantile rq(window, stride, pct);
+                const realseq_t got = rq(wave);
+                Assert(got.size() == rq.size(wave.size()));
+                Assert(got == brute(wave, window, stride, pct));
+            }
+        }
+    }
+}
+
+void test_rows()
+{
+    Array::array_xxf frame = Array::array_xxf::Random(9, 300);
+    Array::array_xxf out;
+    RollingQuantile rq(50, 5);
+    rq.rows(frame, out);
+    Assert(out.rows() == 9 && out.cols() == 60);
+    for (int irow = 0; irow < 9; ++irow) {
+        realseq_t row(300);
+        for (int icol = 0; icol < 300; ++icol) {
+            row[icol] = frame(irow, icol);
+        }
+        const realseq_t want = rq(row);
+        for (int icol = 0; icol < 60; ++icol) {
+            Assert(out(irow, icol) == want[icol]);
+        }
+    }
+}
+
+void test_speed()
+{
+    const realseq_t wave = random_wave(6000, 2);
+    const size_t window = 512;
+    RollingQuantile rq(window);
+    realseq_t a, b;
+    const double t_brute = Testing::time_ms([&]() { a = brute(wave, window, 1, 0.5); });
+    const double t_roll = Testing::time_ms([&]() { b = rq(wave); });
+    Assert(a == b);
+    cerr << "rolling median, window " << window << " over " << wave.size()
+         << " samples: sub-vectors " << t_brute << " ms, rolling " << t_roll << " ms" << endl;
+}
+
+int main()
+{
+    test_same();
+    test_rows();
+    test_speed();
+    return 0;
+}
@@ -0,0 +1,180 @@
+#include "WireCellUtil/SparseWaveform.h"
+#include "WireCellUtil/Array.h"
+#include "WireCellUtil/Exceptions.h"
+#include "WireCellUtil/Testing.h"
+
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace WireCell;
+using namespace WireCell::Waveform;
+
+// A wave of zeros with a few random bumps, some near the ends.
+realseq_t bumpy(std::default_random_engine& re, int nticks, int nbumps)
+{
+    std::uniform_int_distribution<int> where(-5, nticks-1), width(1, 30);
+    std::uniform_real_distribution<float> height(-3, 3);
+    realseq_t ret(nticks, 0);
+    for (int ibump = 0; ibump < nbumps; ++ibump) {
+        const int beg = std::max(0, where(re));
+        const int end = std::min(nticks, beg + width(re));
+        for (int ind = beg; ind < end; ++ind) {
+            ret[ind] += height(re);
+        }
+    }
+    return ret;
+}
+
+void test_roundtrip()
+{
+    std::default_random_engine re(3);
+    for (int trial = 0; trial < 200; ++trial) {
+        const int nticks = 500;
+        const auto wave = bumpy(re, nticks, trial % 8);
+        const auto sw = SparseWave::from_dense(wave);
+        Assert(sw.size() == (size_t)nticks);
+        Assert(sw.dense() == wave);
+        for (int tick = -2; tick < nticks + 2; ++tick) {
+            Assert(sw.at(tick) == (tick < 0 || tick >= nticks ? 0 : wave[tick]));
+        }
+        const auto e = edge(wave);
+        if (sw.empty()) {
+            Assert(e.first == nticks);
+        }
+        else {
+            Assert(sw.start(0) == e.first);
+            const size_t last = sw.nsegments()-1;
+            Assert(sw.start(last) + (int)sw.length(last) == e.second);
+        }
+
+        // threshold and pad
+        const real_t thresh = 1.0;
+        const size_t pad = 3;
+        const auto tw = SparseWave::from_dense(wave, thresh, pad);
+        const auto dense = tw.dense();
+        const auto ranges = tw.ranges();
+        for (size_t iseg = 0; iseg < ranges.size(); ++iseg) {
+            if (iseg) {
+                Assert(ranges[iseg-1].second < ranges[iseg].first);
+            }
+        }
+        for (int tick = 0; tick < nticks; ++tick) {
+            bool near = false;
+            for (int other = std::max(0, tick-(int)pad); other < std::min(nticks, tick+(int)pad+1); ++other) {
+                near = near || std::abs(wave[other]) > thresh;
+            }
+            Assert(dense[tick] == (near ? wave[tick] : 0));
+        }
+    }
+}
+
+void test_arithmetic()
+{
+    std::default_random_engine re(5);
+    for (int trial = 0; trial < 200; ++trial) {
+        const int nticks = 300;
+        const auto wa = bumpy(re, nticks, 5), wb = bumpy(re, nticks, 5);
+        const auto a = SparseWave::from_dense(wa), b = SparseWave::from_dense(wb);
+        const auto c = a + b;
+        const auto dc = c.dense();
+        double sum = 0, sum2 = 0;
+        for (int tick = 0; tick < nticks; ++tick) {
+            Assert(std::abs(dc[tick] - (wa[tick] + wb[tick])) < 1e-6);
+            sum += dc[tick];
+            sum2 += dc[tick]*dc[tick];
+        }
+        Assert(std::abs(c.sum() - sum) < 1e-3);
+        Assert(std::abs(c.sum2() - sum2) < 1e-2);
+        Assert(c.occupancy() <= a.occupancy() + b.occupancy());
+
+        SparseWave d(a);
+        for (size_t iseg = 0; iseg < b.nsegments(); ++iseg) {
+            d.add(b.start(iseg), realseq_t(b.samples(iseg), b.samples(iseg) + b.length(iseg)));
+        }
+        Assert(d.dense() == c.dense());
+
+        d.scale(2);
+        d.increase(1);
+        // only stored samples change
+        const auto dd = d.dense();
+        std::vector<bool> stored(nticks, false);
+        for (const auto& br : c.ranges()) {
+            for (int tick = br.first; tick < br.second; ++tick) {
+                stored[tick] = true;
+            }
+        }
+        for (int tick = 0; tick < nticks; ++tick) {
+            Assert(std::abs(dd[tick] - (stored[tick] ? 2*dc[tick] + 1 : 0)) < 1e-5);
+        }
+        Assert(std::abs(d.sum() - (2*c.sum() + c.occupancy())) < 1e-3);
+    }
+
+    bool caught = false;
+    try {
+        SparseWave(10).add(8, realseq_t(3, 1));
+    }
+    catch (ValueError& err) {
+        caught = true;
+    }
+    Assert(caught);
+}
+
+void test_frame()
+{
+    std::default_random_engine re(9);
+    const int nchans = 480, nticks = 6000;
+    Array::array_xxf frame = Array::array_xxf::Zero(nchans, nticks);
+    std::vector<int> channels(nchans);
+    for (int irow = 0; irow < nchans; ++irow) {
+        channels[irow] = 1000 + 2*irow;
+        const auto wave = bumpy(re, nticks, 3);
+        for (int tick = 0; tick < nticks; ++tick) {
+            frame(irow, tick) = wave[tick];
+        }
+    }
+    auto sf = SparseFrame::from_dense(frame, channels);
+    Assert(sf.nchannels() == (size_t)nchans);
+    Assert(sf.nticks() == (size_t)nticks);
+    Assert(sf.index(1002) == 1);
+    Assert(sf.index(1001) == -1);
+    cerr << "frame occupancy " << sf.occupancy() << " of " << nchans*nticks << " samples" << endl;
+    Assert(sf.occupancy() < size_t(nchans*nticks/10));
+
+    Array::array_xxf back = Array::array_xxf::Constant(nchans, nticks, 7);
+    sf.dense(back);
+    Assert((back == frame).all());
+
+    sf.add(1002, SparseWave::from_dense(realseq_t(nticks, 1)));
+    sf.add(5, SparseWave(nticks));
+    Assert(sf.nchannels() == (size_t)nchans + 1);
+    Assert(sf.at(1).occupancy() == (size_t)nticks);
+    Assert(std::abs(sf.at(1).sum() - (frame.row(1).sum() + nticks)) < 1e-2);
+
+    // frame shapes must match
+    int ncaught = 0;
+    try {
+        SparseFrame::from_dense(frame, std::vector<int>(nchans-1, 0));
+    }
+    catch (ValueError& err) {
+        ++ncaught;
+    }
+    for (auto shape : {std::make_pair(nchans, nticks), std::make_pair(nchans+1, nticks-1)}) {
+        Array::array_xxf wrong(shape.first, shape.second);
+        try {
+            sf.dense(wrong);
+        }
+        catch (ValueError& err) {
+            ++ncaught;
+        }
+    }
+    Assert(ncaught == 3);
+}
+
+int main()
+{
+    test_roundtrip();
+    test_arithmetic();
+    test_frame();
+    return 0;
+}
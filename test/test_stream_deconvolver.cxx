@@ -0,0 +1,85 @@
+#include "WireCellUtil/Array.h"
+#include "WireCellUtil/Exceptions.h"
+#include "WireCellUtil/Testing.h"
+
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace WireCell;
+using namespace WireCell::Array;
+
+// Wrap a kernel with pre acausal ticks into a full frame of ncols.
+array_xxf wrap(const array_xxf& kernel, int pre, int ncols)
+{
+    array_xxf ret = array_xxf::Zero(kernel.rows(), ncols);
+    for (int ind = 0; ind < kernel.cols(); ++ind) {
+        ret.col(((ind - pre) % ncols + ncols) % ncols) += kernel.col(ind);
+    }
+    return ret;
+}
+
+void test_stream(int nrows, int nticks, int pre, int post, int nblock)
+{
+    const int nkern = pre + 1 + post;
+    array_xxf kernel = Eigen::ArrayXXf::Random(nrows, nkern);
+    array_xxf frame = Eigen::ArrayXXf::Random(nrows, nticks);
+    array_xxc filter = dft(wrap(kernel, pre, nticks));
+    array_xxf want = deconv(frame, filter);
+
+    // kernel recovered from the filter
+    array_xxf kern2 = StreamDeconvolver::kernel(filter, pre, post);
+    Assert((kern2 - kernel).abs().maxCoeff() < 1e-4);
+
+    StreamDeconvolver sd(kernel, pre, nblock);
+
+    std::default_random_engine re(nticks);
+    std::uniform_int_distribution<int> dist(0, 2*nblock);
+
+    for (int pass = 0; pass < 2; ++pass) { // second pass checks restart
+        array_xxf got(nrows, 0);
+        int icol = 0;
+        while (icol < nticks) {
+            const int nchunk = std::min(dist(re), nticks - icol);
+            array_xxf out = sd(frame.middleCols(icol, nchunk));
+            got.conservativeResize(nrows, got.cols() + out.cols());
+            got.rightCols(out.cols()) = out;
+            icol += nchunk;
+        }
+        array_xxf out = sd.flush();
+        got.conservativeResize(nrows, got.cols() + out.cols());
+        got.rightCols(out.cols()) = out;
+
+        Assert(got.cols() == nticks);
+        const int beg = post, end = nticks - pre;
+        const float diff = (got.middleCols(beg, end-beg) - want.middleCols(beg, end-beg)).abs().maxCoeff();
+        cerr << "stream(" << nrows << "," << nticks << ") pre=" << pre << " post=" << post
+             << " nblock=" << nblock << " max diff in valid region: " << diff << endl;
+        Assert(diff < 1e-3);
+    }
+}
+
+void test_errors()
+{
+    array_xxf kernel = Eigen::ArrayXXf::Random(4, 10);
+    for (auto args : std::vector<std::pair<int,int> >{{10, 20}, {-1, 20}, {3, 9}}) {
+        bool caught = false;
+        try {
+            StreamDeconvolver sd(kernel, args.first, args.second);
+        }
+        catch (const ValueError&) {
+            caught = true;
+        }
+        Assert(caught);
+    }
+}
+
+int main()
+{
+    test_stream(8, 1000, 5, 20, 64);
+    test_stream(13, 777, 0, 30, 31);
+    test_stream(20, 3000, 40, 40, 512);
+    test_stream(1, 50, 2, 2, 300);
+    test_errors();
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include "WireCellUtil/Waveform.h"
+#include "WireCellUtil/Array.h"
+#include "WireCellUtil/Exceptions.h"
+#include "WireCellUtil/Testing.h"
+
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace WireCell;
+using namespace WireCell::Waveform;
+
+realseq_t random_wave(size_t n, int seed)
+{
+    std::default_random_engine re(seed);
+    std::normal_distribution<float> dist(0, 1);
+    realseq_t ret(n);
+    for (auto& v : ret) {
+        v = dist(re);
+    }
+    return ret;
+}
+
+void assert_close(Span<const real_t> a, Span<const real_t> b)
+{
+    Assert(a.size() == b.size());
+    for (size_t ind = 0; ind < a.size(); ++ind) {
+        Assert(std::abs(a[ind]-b[ind]) < 1e-4);
+    }
+}
+
+void test_same()
+{
+    const realseq_t kern = random_wave(50, 1);
+    Convolver conv(kern, 500);
+    Assert(conv.fft_size() >= 549);
+
+    // signals of various lengths up to the maximum
+    for (size_t nsig : {1, 99, 500}) {
+        const realseq_t sig = random_wave(nsig, nsig);
+        assert_close(conv(sig), linear_convolve(sig, kern));
+        assert_close(conv(sig, false), linear_convolve(sig, kern, false));
+    }
+
+    std::vector<realseq_t> sigs, outs;
+    for (int ind = 0; ind < 10; ++ind) {
+        sigs.push_back(random_wave(400 + ind, ind));
+    }
+    conv(sigs, outs);
+    Assert(outs.size() == sigs.size());
+    for (size_t ind = 0; ind < sigs.size(); ++ind) {
+        assert_close(outs[ind], linear_convolve(sigs[ind], kern));
+    }
+
+    Array::array_xxf frame = Array::array_xxf::Random(7, 300);
+    Array::array_xxf orig = frame;
+    conv.rows(frame);
+    realseq_t row(300);
+    for (int irow = 0; irow < 7; ++irow) {
+        for (int icol = 0; icol < 300; ++icol) {
+            row[icol] = orig(irow, icol);
+        }
+        assert_close(frame.row(irow), linear_convolve(row, kern));
+    }
+
+    bool caught = false;
+    try {
+        conv(random_wave(501, 0));
+    }
+    catch (const ValueError&) {
+        caught = true;
+    }
+    Assert(caught);
+}
+
+void test_speed()
+{
+    const int nchan = 2000, ntick = 6000;
+    const realseq_t resp = random_wave(200, 3);
+    std::vector<realseq_t> sigs, outs(nchan, realseq_t(ntick));
+    for (int ichan = 0; ichan < nchan; ++ichan) {
+        sigs.push_back(random_wave(ntick, ichan));
+    }
+    Convolver conv(resp, ntick);
+
+    double t_call = Testing::time_ms([&]() {
+            for (int ichan = 0; ichan < nchan; ++ichan) {
+                linear_convolve(sigs[ichan], resp, outs[ichan]);
+            }
+        });
+    double t_conv = Testing::time_ms([&]() { conv(sigs, outs); });
+    cerr << "convolve " << nchan << " channels: linear_convolve " << t_call
+         << " ms, Convolver " << t_conv << " ms" << endl;
+}
+
+int main()
+{
+    test_same();
+    test_speed();
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include "WireCellUtil/Waveform.h"
+#include "WireCellUtil/Response.h"
+#include "WireCellUtil/Units.h"
+#include "WireCellUtil/Testing.h"
+
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace WireCell;
+using namespace WireCell::Waveform;
+
+realseq_t random_wave(size_t n, int seed)
+{
+    std::default_random_engine re(seed);
+    std::normal_distribution<float> dist(0, 1);
+    realseq_t ret(n);
+    for (auto& v : ret) {
+        v = dist(re);
+    }
+    return ret;
+}
+
+void test_half()
+{
+    for (int nsamples : {1, 2, 9, 100, 101}) {
+        const realseq_t wave = random_wave(nsamples, nsamples);
+        const compseq_t full = dft(wave);
+        const compseq_t half = rfft(wave);
+        Assert((int)half.size() == nsamples/2+1);
+        for (size_t ind = 0; ind < half.size(); ++ind) {
+            Assert(std::abs(half[ind] - full[ind]) < 1e-4);
+        }
+        const realseq_t back = irfft(half, nsamples);
+        Assert((int)back.size() == nsamples);
+        for (int ind = 0; ind < nsamples; ++ind) {
+            Assert(std::abs(back[ind] - wave[ind]) < 1e-5);
+        }
+    }
+}
+
+void test_filter()
+{
+    const int nticks = 6000;
+    const double max_freq = 2*units::megahertz;
+    Response::HfFilter hf(0.1, 2, true);
+
+    const realseq_t half = hf.half_spectrum(max_freq, nticks);
+    const realseq_t full = hf.generate(Domain(0, max_freq), nticks);
+    Assert((int)half.size() == nticks/2+1);
+    for (size_t ind = 0; ind < half.size(); ++ind) {
+        Assert(half[ind] == full[ind]);
+    }
+
+    // filter in full and in half spectrum, the full filter made
+    // symmetric as is done when it is applied
+    realseq_t sym = full;
+    for (int ind = nticks/2+1; ind < nticks; ++ind) {
+        sym[ind] = full[nticks-ind];
+    }
+    const realseq_t wave = random_wave(nticks, 1);
+
+    realseq_t byfull, byhalf;
+    const double t_full = Testing::time_ms([&]() {
+            compseq_t spec = dft(wave);
+            for (int ind = 0; ind < nticks; ++ind) {
+                spec[ind] *= sym[ind];
+            }
+            byfull = idft(spec);
+        });
+    const double t_half = Testing::time_ms([&]() {
+            compseq_t spec = rfft(wave);
+            for (size_t ind = 0; ind < spec.size(); ++ind) {
+                spec[ind] *= half[ind];
+            }
+            byhalf = irfft(spec, nticks);
+        });
+    for (int ind = 0; ind < nticks; ++ind) {
+        Assert(std::abs(byfull[ind] - byhalf[ind]) < 1e-4);
+    }
+    cerr << "filter " << nticks << " ticks: full spectrum " << t_full
+         << " ms, half spectrum " << t_half << " ms" << endl;
+}
+
+int main()
+{
+    test_half();
+    test_filter();
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include "WireCellUtil/Waveform.h"
+#include "WireCellUtil/Testing.h"
+
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace WireCell;
+using namespace WireCell::Waveform;
+
+realseq_t random_wave(size_t n, int seed)
+{
+    std::default_random_engine re(seed);
+    std::normal_distribution<float> dist(0, 10);
+    realseq_t ret(n);
+    for (auto& v : ret) {
+        v = std::round(dist(re));  // many ties, as ADC-like data
+    }
+    return ret;
+}
+
+// The original, sorting implementation.
+real_t sorted_percentile(realseq_t wave, real_t percentage)
+{
+    std::sort(wave.begin(), wave.end());
+    return wave[wave.size() * percentage];
+}
+
+void test_same()
+{
+    const std::vector<real_t> qs = {0.9, 0.1, 0.5, 0.5, 0.0, 0.999};
+    for (size_t n : {1, 2, 3, 10, 101, 6000}) {
+        const realseq_t wave = random_wave(n, n);
+        Assert(median(wave) == sorted_percentile(wave, 0.5));
+        Assert(median_select(Span<const real_t>(wave)) == sorted_percentile(wave, 0.5));
+        for (real_t q : qs) {
+            realseq_t scratch = wave;
+            Assert(percentile_select(scratch, q) == sorted_percentile(wave, q));
+            Assert(percentile(wave, q) == sorted_percentile(wave, q));
+        }
+        realseq_t scratch = wave;
+        const auto got = percentiles(scratch, qs);
+        Assert(got.size() == qs.size());
+        for (size_t iq = 0; iq < qs.size(); ++iq) {
+            Assert(got[iq] == sorted_percentile(wave, qs[iq]));
+        }
+        Assert(percentiles(Span<const real_t>(wave), qs) == got);
+    }
+    realseq_t empty;
+    Assert(median_select(empty) == 0);
+}
+
+void test_speed()
+{
+    const int nchan = 2000;
+    std::vector<realseq_t> waves;
+    for (int ichan = 0; ichan < nchan; ++ichan) {
+        waves.push_back(random_wave(6000, ichan));
+    }
+    real_t sum1 = 0, sum2 = 0;
+    const double t_sort = Testing::time_ms([&]() {
+            for (const auto& wave : waves) {
+                sum1 += sorted_percentile(wave, 0.5);
+            }
+        });
+    realseq_t scratch;
+    const double t_select = Testing::time_ms([&]() {
+            for (const auto& wave : waves) {
+                scratch = wave;
+                sum2 += median_select(scratch);
+            }
+        });
+    Assert(sum1 == sum2);
+    cerr << "median of " << nchan << " channels: sort " << t_sort
+         << " ms, select " << t_select << " ms" << endl;
+}
+
+int main()
+{
+    test_same();
+    test_speed();
+    return 0;
+}
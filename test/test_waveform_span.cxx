@@ -0,0 +1,117 @@
+#include "WireCellUtil/Waveform.h"
+#include "WireCellUtil/Array.h"
+#include "WireCellUtil/Exceptions.h"
+#include "WireCellUtil/Testing.h"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace WireCell;
+using namespace WireCell::Waveform;
+
+realseq_t random_wave(size_t n, int seed)
+{
+    std::default_random_engine re(seed);
+    std::normal_distribution<float> dist(0, 1);
+    realseq_t ret(n);
+    for (auto& v : ret) {
+        v = dist(re);
+    }
+    return ret;
+}
+
+// Direct, time domain linear convolution.
+realseq_t direct_convolve(const realseq_t& a, const realseq_t& b)
+{
+    realseq_t ret(a.size()+b.size()-1, 0);
+    for (size_t i = 0; i < a.size(); ++i) {
+        for (size_t j = 0; j < b.size(); ++j) {
+            ret[i+j] += a[i]*b[j];
+        }
+    }
+    return ret;
+}
+
+void assert_close(Span<const real_t> a, Span<const real_t> b, double tol=1e-4)
+{
+    Assert(a.size() == b.size());
+    for (size_t ind = 0; ind < a.size(); ++ind) {
+        Assert(std::abs(a[ind]-b[ind]) < tol);
+    }
+}
+
+void test_dft()
+{
+    Array::array_xxf arr = Array::array_xxf::Random(5, 64);
+    compseq_t spec(64);
+    dft(arr.row(2), spec);
+    realseq_t copy(64);
+    for (int ind = 0; ind < 64; ++ind) {
+        copy[ind] = arr(2, ind);
+    }
+    const compseq_t want = dft(copy);
+    for (int ind = 0; ind < 64; ++ind) {
+        Assert(std::abs(spec[ind] - want[ind]) < 1e-5);
+    }
+
+    // back into another row
+    idft(spec, arr.row(4));
+    assert_close(arr.row(4), copy);
+
+    bool caught = false;
+    try {
+        compseq_t short_spec(10);
+        dft(copy, short_spec);
+    }
+    catch (const ValueError&) {
+        caught = true;
+    }
+    Assert(caught);
+}
+
+void test_convolve()
+{
+    const realseq_t a = random_wave(100, 1), b = random_wave(37, 2);
+    const realseq_t want = direct_convolve(a, b);
+
+    realseq_t full(want.size()), trunc(a.size());
+    linear_convolve(a, b, full);
+    linear_convolve(a, b, trunc);
+    assert_close(full, want);
+    assert_close(trunc, Span<const real_t>(want.data(), a.size()));
+    assert_close(linear_convolve(a, b, false), want);
+
+    // replacing a response by itself changes nothing
+    realseq_t same(a.size());
+    replace_convolve(a, b, b, same);
+    assert_close(same, a);
+
+    // replacing b by a delta deconvolves it
+    realseq_t delta(b.size(), 0);
+    delta[0] = 1;
+    realseq_t back(a.size());
+    replace_convolve(want, delta, b, back);
+    assert_close(back, a, 1e-3);
+    const realseq_t byvalue = replace_convolve(want, delta, b);
+    assert_close(Span<const real_t>(byvalue.data(), a.size()), back, 1e-3);
+
+    // an old response with no DC component: the span form zeroes
+    // that bin, the sequence form divides by zero as it always has
+    const realseq_t nodc{1, -1};
+    realseq_t safe(a.size());
+    replace_convolve(a, b, nodc, safe);
+    for (auto val : safe) {
+        Assert(std::isfinite(val));
+    }
+    const realseq_t legacy = replace_convolve(a, b, nodc);
+    Assert(!std::isfinite(legacy[0]));
+}
+
+int main()
+{
+    test_dft();
+    test_convolve();
+    return 0;
+}